@@ -0,0 +1,137 @@
+#include "barnes_hut.hpp"
+
+#include <algorithm>
+#include <cfloat>
+
+// Deep enough to separate any bodies that are not practically coincident, shallow enough that node
+// centres stay representable in float precision.
+const int MAX_TREE_DEPTH = 20;
+
+int BarnesHutTree::quadrant(const Node &node, vec2 p) const {
+    return (p.x >= node.centre.x ? 1 : 0) + (p.y >= node.centre.y ? 2 : 0);
+}
+
+void BarnesHutTree::subdivide(int node_index) {
+    int first_child = (int) nodes.size();
+    float half_size = nodes[node_index].half_size / 2.f;
+    vec2 centre = nodes[node_index].centre;
+    for (int q = 0; q < 4; q++) {
+        Node child;
+        child.centre = centre + half_size * vec2(q & 1 ? 1.f : -1.f, q & 2 ? 1.f : -1.f);
+        child.half_size = half_size;
+        nodes.push_back(child);
+    }
+    nodes[node_index].first_child = first_child;
+}
+
+void BarnesHutTree::insert(int body) {
+    vec2 p = positions[body];
+    float m = masses[body];
+    int node_index = 0;
+    for (int depth = 0;; depth++) {
+        Node &node = nodes[node_index];
+        bool empty_leaf = node.count == 0;
+        node.mass_position += m * p;
+        node.mass += m;
+        node.count++;
+        if (empty_leaf) {
+            node.body = body;
+            return;
+        }
+        // Coincident bodies stop splitting and share one aggregate leaf.
+        if (depth == MAX_TREE_DEPTH && node.first_child < 0) {
+            node.body = -1;
+            return;
+        }
+        if (node.first_child < 0) {
+            int resident = node.body;
+            node.body = -1;
+            subdivide(node_index);
+            if (resident >= 0) {
+                Node &child = nodes[nodes[node_index].first_child + quadrant(nodes[node_index], positions[resident])];
+                child.mass_position += masses[resident] * positions[resident];
+                child.mass += masses[resident];
+                child.count = 1;
+                child.body = resident;
+            }
+        }
+        node_index = nodes[node_index].first_child + quadrant(nodes[node_index], p);
+    }
+}
+
+void BarnesHutTree::build(const std::vector<vec2> &body_positions, const std::vector<float> &body_masses) {
+    positions = body_positions;
+    masses = body_masses;
+    nodes.clear();
+
+    vec2 lower(FLT_MAX, FLT_MAX);
+    vec2 upper(-FLT_MAX, -FLT_MAX);
+    for (vec2 p: positions) {
+        lower = min(lower, p);
+        upper = max(upper, p);
+    }
+
+    Node root;
+    root.centre = positions.empty() ? vec2(0.f, 0.f) : (lower + upper) / 2.f;
+    root.half_size = positions.empty() ? 1.f : max(max(upper.x - lower.x, upper.y - lower.y) / 2.f, 1.f) * 1.001f;
+    nodes.push_back(root);
+
+    for (int i = 0; i < (int) positions.size(); i++)
+        insert(i);
+}
+
+vec2 BarnesHutTree::acceleration(vec2 p, int self, float theta, float gravity_constant, float softening) const {
+    vec2 total(0.f, 0.f);
+    if (nodes.empty())
+        return total;
+
+    // The nodes on the way to self's leaf still hold its mass. While p is where self was built they contain
+    // p and are opened, but once self has moved on they may be approximated and would pull it towards
+    // itself, so its mass is taken out of them.
+    int home_path[MAX_TREE_DEPTH + 1];
+    int home_depth = 0;
+    if (self >= 0 && p != positions[self])
+        for (int n = 0;; n = nodes[n].first_child + quadrant(nodes[n], positions[self])) {
+            home_path[home_depth++] = n;
+            if (nodes[n].first_child < 0)
+                break;
+        }
+
+    int stack[4 * MAX_TREE_DEPTH + 4];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        int node_index = stack[--top];
+        const Node &node = nodes[node_index];
+        if (node.mass == 0.f || (node.first_child < 0 && node.body == self && self >= 0))
+            continue;
+
+        float mass = node.mass;
+        vec2 mass_position = node.mass_position;
+        if (std::find(home_path, home_path + home_depth, node_index) != home_path + home_depth) {
+            mass -= masses[self];
+            mass_position -= masses[self] * positions[self];
+            if (mass <= 0.f)
+                continue;
+        }
+
+        vec2 com = mass_position / mass;
+        vec2 dp = com - p;
+        float dist_squared = dot(dp, dp);
+        vec2 offset = abs(p - node.centre);
+        bool contains_p = offset.x <= node.half_size && offset.y <= node.half_size;
+        float size = 2.f * node.half_size;
+
+        if (node.first_child < 0 || (!contains_p && size * size < theta * theta * dist_squared)) {
+            // An aggregate leaf around p only exists at maximum depth, i.e. its bodies sit on top of p.
+            if (dist_squared == 0.f || (node.first_child < 0 && node.count > 1 && contains_p))
+                continue;
+            float softened = dist_squared + softening * softening;
+            total += (gravity_constant * mass / (softened * sqrt(softened))) * dp;
+        } else {
+            for (int q = 0; q < 4; q++)
+                stack[top++] = node.first_child + q;
+        }
+    }
+    return total;
+}
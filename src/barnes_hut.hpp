@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+
+#include "common.hpp"
+
+// Quadtree over point masses for O(n log n) gravity. Rebuilt from scratch every physics step.
+class BarnesHutTree {
+    struct Node {
+        vec2 centre;
+        float half_size;
+        vec2 mass_position = {0.f, 0.f};
+        float mass = 0.f;
+        int count = 0;
+        int first_child = -1;
+        int body = -1;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<vec2> positions;
+    std::vector<float> masses;
+
+    int quadrant(const Node &node, vec2 p) const;
+
+    void subdivide(int node_index);
+
+    void insert(int body);
+
+public:
+    void build(const std::vector<vec2> &body_positions, const std::vector<float> &body_masses);
+
+    // Acceleration at p from every body except `self` (an index into the build arrays, or -1), Plummer-
+    // softened by `softening`. p need not be where self was built. A node is treated as a single mass when
+    // size / distance < theta and p lies outside it.
+    vec2 acceleration(vec2 p, int self, float theta, float gravity_constant, float softening) const;
+};
@@ -1,6 +1,7 @@
 #include "camera_system.hpp"
 
 #include "callback_system.hpp"
+#include "physics_system.hpp"
 #include "tiny_ecs_registry.hpp"
 
 
@@ -33,7 +34,8 @@ void CameraSystem::step(float elapsed_ms) {
     float camera_speed = camera_size.y + camera.z;
     vec3 change = camera_speed * (elapsed_ms / 1000.f) * vec3(camera_velocity, 0.f);
     if (locked_on && registry.motions.has(locked_on_entity)) {
-        change = vec3(registry.motions.get(locked_on_entity).position, 10.f) - camera;
+        const Motion &motion = registry.motions.peek(locked_on_entity);
+        change = vec3(physics_system.render_position(locked_on_entity, motion), 10.f) - camera;
         if (move_timer > 0.f) {
             if (elapsed_ms < move_timer)
                 change *= elapsed_ms / move_timer;
@@ -4,6 +4,8 @@
 
 #include "../ext/stb_image/stb_image.h"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 Debug debugging;
@@ -97,3 +99,47 @@ bool Mesh::loadFromOBJFile(std::string obj_path, std::vector<ColoredVertex> &out
 
     return true;
 }
+
+void Mesh::compute_bounds() {
+    std::vector<vec2> points;
+    bounding_radius = 0.f;
+    for (const ColoredVertex &vertex: vertices) {
+        points.push_back(vec2(vertex.position));
+        bounding_radius = std::max(bounding_radius, length(points.back()));
+    }
+    std::sort(points.begin(), points.end(), [](vec2 a, vec2 b) { return a.x < b.x || (a.x == b.x && a.y < b.y); });
+    points.erase(std::unique(points.begin(), points.end()), points.end());
+
+    // Andrew's monotone chain: lower hull left to right, then upper hull back.
+    auto cross = [](vec2 o, vec2 a, vec2 b) { return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x); };
+    std::vector<vec2> hull;
+    for (int pass = 0; pass < 2; pass++) {
+        size_t chain_start = hull.size();
+        for (const vec2 &p: points) {
+            while (hull.size() >= chain_start + 2 && cross(hull[hull.size() - 2], hull.back(), p) <= 0.f)
+                hull.pop_back();
+            hull.push_back(p);
+        }
+        hull.pop_back();
+        std::reverse(points.begin(), points.end());
+    }
+    if (hull.empty() && !points.empty())
+        hull.push_back(points.front());
+
+    hull_x.clear();
+    hull_y.clear();
+    for (size_t i = 0; i <= hull.size() && !hull.empty(); i++) {
+        hull_x.push_back(hull[i % hull.size()].x);
+        hull_y.push_back(hull[i % hull.size()].y);
+    }
+}
+
+vec2 AngularMotion::position_at(double seconds) const {
+    double angle = phase + angular_rate * seconds;
+    return centre + radius * vec2((float) cos(angle), (float) sin(angle));
+}
+
+vec2 AngularMotion::velocity_at(double seconds) const {
+    double angle = phase + angular_rate * seconds;
+    return radius * angular_rate * vec2((float) -sin(angle), (float) cos(angle));
+}
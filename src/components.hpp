@@ -32,7 +32,19 @@ struct IgnorePhysics {
 };
 struct SmokeParticle {
 };
+// Circular orbit on rails: a closed-form function of the physics clock rather than integrated state, so
+// it never drifts and can be sampled at any time. A zero radius holds the body still at the centre.
 struct AngularMotion {
+    vec2 centre = {0.f, 0.f};
+    float radius = 0.f;
+    // Angle at time zero, counter-clockwise from +x.
+    float phase = 0.f;
+    // Radians per second.
+    float angular_rate = 0.f;
+
+    vec2 position_at(double seconds) const;
+
+    vec2 velocity_at(double seconds) const;
 };
 struct PlanetName {
 };
@@ -40,6 +52,9 @@ struct Wormhole {
 };
 struct Hide {
 };
+// Maintained by the physics system for bodies heavy enough to act as gravity sources.
+struct Attractor {
+};
 
 struct Missile {
     float damage;
@@ -65,6 +80,10 @@ struct Timer {
     bool death = false;
 };
 
+template<>
+struct stable_storage<Timer> : std::true_type {
+};
+
 struct SpeedUp {
     float boost = 2.3f;
     float ms = 5000.f;
@@ -78,12 +97,19 @@ struct Motion {
     float angle = 0.f;
     float mass = 1.f;
     float radius = 0;
+    // State at the start of the last physics step, blended with the current state when rendering.
+    vec2 previous_position = {0.f, 0.f};
+    float previous_angle = 0.f;
+};
+
+template<>
+struct stable_storage<Motion> : std::true_type {
 };
 
 struct Collision {
     Entity other_entity;
 
-    Collision(Entity &other_entity) { this->other_entity = other_entity; };
+    Collision(Entity &other_entity) : other_entity(other_entity) {};
 };
 
 struct Debug {
@@ -136,6 +162,15 @@ struct Mesh {
     vec2 original_size = {1, 1};
     std::vector<ColoredVertex> vertices;
     std::vector<uint16_t> vertex_indices;
+
+    // Collision shape in the xy plane, in mesh units (before Motion.scale), filled by compute_bounds().
+    // The hull is counter-clockwise, split into x and y arrays, with its first point repeated at the end
+    // so edge i runs from point i to point i + 1.
+    float bounding_radius = 0.f;
+    std::vector<float> hull_x;
+    std::vector<float> hull_y;
+
+    void compute_bounds();
 };
 
 enum class TEXTURE_ASSET_ID {
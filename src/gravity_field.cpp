@@ -0,0 +1,158 @@
+#include "gravity_field.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Within this many cells of a cached attractor everything is summed exactly. It has to exceed a cell
+// diagonal plus the distance an attractor travels between keyframes, so no sample ever spans a pole.
+const float EXACT_RADIUS_CELLS = 4.f;
+
+static bool orbiting(const AngularMotion &orbit) {
+    return orbit.radius != 0.f && orbit.angular_rate != 0.f;
+}
+
+static vec2 pull(vec2 dp, float mass, float gravity_constant, float softening) {
+    float softened = dot(dp, dp) + softening * softening;
+    if (softened == 0.f)
+        return {0.f, 0.f};
+    return (gravity_constant * mass) / (softened * sqrt(softened)) * dp;
+}
+
+GravityField::GravityField(vec2 centre, vec2 size, float cell_size) :
+        origin(centre - size / 2.f),
+        cell_size(cell_size),
+        columns(std::max(1, (int) std::ceil(size.x / cell_size))),
+        rows(std::max(1, (int) std::ceil(size.y / cell_size))) {
+}
+
+void GravityField::update(const std::vector<AngularMotion> &orbits, const std::vector<float> &masses,
+                          float gravity_constant, float softening) {
+    auto same_orbit = [](const AngularMotion &a, const AngularMotion &b) {
+        return a.centre == b.centre && a.radius == b.radius && a.phase == b.phase &&
+               a.angular_rate == b.angular_rate;
+    };
+    if (gravity_constant == this->gravity_constant && softening == this->softening && masses == this->masses &&
+        std::equal(orbits.begin(), orbits.end(), this->orbits.begin(), this->orbits.end(), same_orbit))
+        return;
+    this->gravity_constant = gravity_constant;
+    this->softening = softening;
+    this->orbits = orbits;
+    this->masses = masses;
+
+    float fastest = 0.f;
+    for (const AngularMotion &orbit: orbits)
+        if (orbiting(orbit))
+            fastest = std::max(fastest, orbit.radius * std::abs(orbit.angular_rate));
+    keyframe_seconds = fastest > 0.f ? cell_size / fastest : 0.0;
+    keyframe_index[0] = keyframe_index[1] = -1;
+    positions.clear();
+
+    static_nodes.assign((size_t) (columns + 1) * (rows + 1), {0.f, 0.f});
+    static_near.assign((size_t) columns * rows, 0);
+    for (size_t k = 0; k < orbits.size(); k++)
+        if (!orbiting(orbits[k]))
+            add_attractor(static_nodes, static_near, orbits[k].position_at(0.0), masses[k], 0.f);
+}
+
+// Adds an attractor's pull to every node, and flags the cells it may reach within the exact radius after
+// moving up to `travel` further.
+void GravityField::add_attractor(std::vector<vec2> &nodes, std::vector<unsigned char> &near, vec2 position,
+                                 float mass, float travel) const {
+    for (int r = 0; r <= rows; r++)
+        for (int c = 0; c <= columns; c++)
+            nodes[r * (columns + 1) + c] += pull(position - (origin + cell_size * vec2(c, r)), mass,
+                                                 gravity_constant, softening);
+
+    float reach = EXACT_RADIUS_CELLS * cell_size + travel + cell_size * (float) M_SQRT1_2;
+    vec2 cell = (position - origin) / cell_size;
+    int c0 = std::max(0, (int) std::floor(cell.x - reach / cell_size));
+    int c1 = std::min(columns - 1, (int) std::floor(cell.x + reach / cell_size));
+    int r0 = std::max(0, (int) std::floor(cell.y - reach / cell_size));
+    int r1 = std::min(rows - 1, (int) std::floor(cell.y + reach / cell_size));
+    for (int r = r0; r <= r1; r++)
+        for (int c = c0; c <= c1; c++) {
+            vec2 dp = origin + cell_size * vec2(c + 0.5f, r + 0.5f) - position;
+            if (dot(dp, dp) < reach * reach)
+                near[r * columns + c] = 1;
+        }
+}
+
+// The static grid plus every orbiting attractor where it is at keyframe `index`, returned as its slot.
+// Only two keyframes are kept. A new one overwrites the slot not holding its predecessor, which
+// set_time() has just asked for, and failing that the one not holding its successor.
+int GravityField::keyframe(long long index) {
+    for (int slot = 0; slot < 2; slot++)
+        if (keyframe_index[slot] == index)
+            return slot;
+    int slot = keyframe_index[0] == index - 1 ? 1 :
+               keyframe_index[1] == index - 1 ? 0 :
+               keyframe_index[0] == index + 1 ? 1 : 0;
+    keyframe_index[slot] = index;
+    keyframes[slot] = static_nodes;
+    keyframe_near[slot] = static_near;
+    // Orbits are spaced so nothing travels more than a cell to the next keyframe.
+    for (size_t k = 0; k < orbits.size(); k++)
+        if (orbiting(orbits[k]))
+            add_attractor(keyframes[slot], keyframe_near[slot], orbits[k].position_at(index * keyframe_seconds),
+                          masses[k], cell_size);
+    return slot;
+}
+
+void GravityField::set_time(double seconds) {
+    positions.resize(orbits.size());
+    for (size_t k = 0; k < orbits.size(); k++)
+        positions[k] = orbits[k].position_at(seconds);
+    if (keyframe_seconds == 0.0) {
+        from = to = &static_nodes;
+        near_cells = &static_near;
+        blend = 0.f;
+        return;
+    }
+    double t = seconds / keyframe_seconds;
+    long long index = (long long) std::floor(t);
+    int from_slot = keyframe(index);
+    int to_slot = keyframe(index + 1);
+    from = &keyframes[from_slot];
+    to = &keyframes[to_slot];
+    near_cells = &keyframe_near[from_slot];
+    blend = (float) (t - index);
+}
+
+vec2 GravityField::exact(vec2 p) const {
+    vec2 total(0.f, 0.f);
+    for (size_t k = 0; k < positions.size(); k++)
+        total += pull(positions[k] - p, masses[k], gravity_constant, softening);
+    return total;
+}
+
+vec2 GravityField::sample(vec2 cell) const {
+    int c = std::min((int) cell.x, columns - 1);
+    int r = std::min((int) cell.y, rows - 1);
+    size_t i = (size_t) r * (columns + 1) + c;
+    size_t above = i + columns + 1;
+    const std::vector<vec2> &a = *from;
+    const std::vector<vec2> &b = *to;
+    // Blending in time first lets both keyframes share one set of bilinear weights.
+    vec2 bottom = mix(mix(a[i], b[i], blend), mix(a[i + 1], b[i + 1], blend), cell.x - c);
+    vec2 top = mix(mix(a[above], b[above], blend), mix(a[above + 1], b[above + 1], blend), cell.x - c);
+    return mix(bottom, top, cell.y - r);
+}
+
+vec2 GravityField::acceleration(vec2 p) const {
+    if (positions.empty())
+        return {0.f, 0.f};
+    vec2 cell = (p - origin) / cell_size;
+    if (!(cell.x >= 0.f && cell.y >= 0.f && cell.x <= columns && cell.y <= rows))
+        return exact(p);
+    int c = std::min((int) cell.x, columns - 1);
+    int r = std::min((int) cell.y, rows - 1);
+    if (!(*near_cells)[r * columns + c])
+        return sample(cell);
+    float exact_radius = EXACT_RADIUS_CELLS * cell_size;
+    for (vec2 position: positions) {
+        vec2 dp = position - p;
+        if (dot(dp, dp) < exact_radius * exact_radius)
+            return exact(p);
+    }
+    return sample(cell);
+}
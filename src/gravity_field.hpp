@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+
+#include "common.hpp"
+#include "components.hpp"
+
+// Precomputed gravity of attractors on rails, sampled with bilinear interpolation instead of summed.
+// Attractors that stand still are baked into one static grid. Orbiting ones are added on top in keyframes
+// spaced so that none moves more than a cell between two, and the two keyframes around the current time
+// are blended linearly. Close to a cached attractor, or outside the grid, they are all summed exactly,
+// since 1/r^2 cannot be interpolated near its pole.
+class GravityField {
+    vec2 origin;
+    float cell_size;
+    int columns;
+    int rows;
+    float gravity_constant = 0.f;
+    float softening = 0.f;
+
+    std::vector<AngularMotion> orbits;
+    std::vector<float> masses;
+    // Acceleration at every grid node from the attractors that stand still.
+    std::vector<vec2> static_nodes;
+    // Seconds between keyframes, 0 when nothing cached orbits.
+    double keyframe_seconds = 0.0;
+    // Two resident keyframes and the multiple of keyframe_seconds each was taken at, -1 if none.
+    std::vector<vec2> keyframes[2];
+    long long keyframe_index[2] = {-1, -1};
+    // Per cell, whether an attractor may come within the exact radius of it before the next keyframe;
+    // only flagged cells pay for a per-attractor distance check.
+    std::vector<unsigned char> static_near;
+    std::vector<unsigned char> keyframe_near[2];
+
+    // Set by set_time().
+    std::vector<vec2> positions;
+    const std::vector<vec2> *from = nullptr;
+    const std::vector<vec2> *to = nullptr;
+    const std::vector<unsigned char> *near_cells = nullptr;
+    float blend = 0.f;
+
+    vec2 exact(vec2 p) const;
+
+    void add_attractor(std::vector<vec2> &nodes, std::vector<unsigned char> &near, vec2 position, float mass,
+                       float travel) const;
+
+    int keyframe(long long index);
+
+    // Bilinear in space and linear in time, at a point given in cells from the origin.
+    vec2 sample(vec2 cell) const;
+
+public:
+    GravityField(vec2 centre, vec2 size, float cell_size);
+
+    // Caches the given attractors, rebuilding only if they differ from the ones already cached.
+    void update(const std::vector<AngularMotion> &orbits, const std::vector<float> &masses, float gravity_constant,
+                float softening);
+
+    // Moves the cached attractors to the given simulation time for the acceleration() calls that follow.
+    void set_time(double seconds);
+
+    // Acceleration at p from all cached attractors. Safe to call concurrently.
+    vec2 acceleration(vec2 p) const;
+};
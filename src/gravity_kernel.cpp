@@ -0,0 +1,177 @@
+#include "gravity_kernel.hpp"
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define GRAVITY_KERNEL_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// Each kernel fills the receivers from begin that it can handle in full vectors before end and
+// returns where it stopped; the scalar kernel finishes the tail.
+typedef size_t (*GravityKernel)(const GravityBodies &receivers, const GravityBodies &sources,
+                                float gravity_constant, float softening, float *ax, float *ay,
+                                size_t begin, size_t end);
+
+static void gravity_scalar_range(const GravityBodies &receivers, const GravityBodies &sources,
+                                 float gravity_constant, float softening, float *ax, float *ay,
+                                 size_t begin, size_t end) {
+    float softening_squared = softening * softening;
+    for (size_t i = begin; i < end; i++) {
+        float sum_x = 0.f;
+        float sum_y = 0.f;
+        for (size_t j = 0; j < sources.size(); j++) {
+            float dx = sources.x[j] - receivers.x[i];
+            float dy = sources.y[j] - receivers.y[i];
+            float dist_squared = dx * dx + dy * dy;
+            if (dist_squared == 0.f)
+                continue;
+            float inv_dist = 1.f / std::sqrt(dist_squared + softening_squared);
+            float force = gravity_constant * sources.mass[j] * inv_dist * inv_dist * inv_dist;
+            sum_x += force * dx;
+            sum_y += force * dy;
+        }
+        ax[i] = sum_x;
+        ay[i] = sum_y;
+    }
+}
+
+#ifndef GRAVITY_KERNEL_X86
+
+static size_t gravity_scalar(const GravityBodies &, const GravityBodies &, float, float, float *, float *,
+                             size_t begin, size_t) {
+    return begin;
+}
+
+#else
+
+// SSE is part of the x86-64 baseline, so this path needs no target attribute.
+static size_t gravity_sse(const GravityBodies &receivers, const GravityBodies &sources,
+                          float gravity_constant, float softening, float *ax, float *ay, size_t begin, size_t end) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 three_halves = _mm_set1_ps(1.5f);
+    const __m128 softening_squared = _mm_set1_ps(softening * softening);
+    size_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m128 px = _mm_loadu_ps(&receivers.x[i]);
+        __m128 py = _mm_loadu_ps(&receivers.y[i]);
+        __m128 sum_x = zero;
+        __m128 sum_y = zero;
+        for (size_t j = 0; j < sources.size(); j++) {
+            __m128 dx = _mm_sub_ps(_mm_set1_ps(sources.x[j]), px);
+            __m128 dy = _mm_sub_ps(_mm_set1_ps(sources.y[j]), py);
+            __m128 dist_squared = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+            __m128 softened = _mm_add_ps(dist_squared, softening_squared);
+            __m128 inv_dist = _mm_rsqrt_ps(softened);
+            inv_dist = _mm_mul_ps(inv_dist, _mm_sub_ps(three_halves, _mm_mul_ps(_mm_mul_ps(half, softened),
+                                                                                 _mm_mul_ps(inv_dist, inv_dist))));
+            __m128 force = _mm_mul_ps(_mm_set1_ps(gravity_constant * sources.mass[j]),
+                                      _mm_mul_ps(inv_dist, _mm_mul_ps(inv_dist, inv_dist)));
+            force = _mm_and_ps(force, _mm_cmpgt_ps(dist_squared, zero));
+            sum_x = _mm_add_ps(sum_x, _mm_mul_ps(force, dx));
+            sum_y = _mm_add_ps(sum_y, _mm_mul_ps(force, dy));
+        }
+        _mm_storeu_ps(ax + i, sum_x);
+        _mm_storeu_ps(ay + i, sum_y);
+    }
+    return i;
+}
+
+TARGET_AVX2 static size_t gravity_avx2(const GravityBodies &receivers, const GravityBodies &sources,
+                                       float gravity_constant, float softening, float *ax, float *ay,
+                                 size_t begin, size_t end) {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 three_halves = _mm256_set1_ps(1.5f);
+    const __m256 softening_squared = _mm256_set1_ps(softening * softening);
+    size_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256 px = _mm256_loadu_ps(&receivers.x[i]);
+        __m256 py = _mm256_loadu_ps(&receivers.y[i]);
+        __m256 sum_x = zero;
+        __m256 sum_y = zero;
+        for (size_t j = 0; j < sources.size(); j++) {
+            __m256 dx = _mm256_sub_ps(_mm256_set1_ps(sources.x[j]), px);
+            __m256 dy = _mm256_sub_ps(_mm256_set1_ps(sources.y[j]), py);
+            __m256 dist_squared = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+            __m256 softened = _mm256_add_ps(dist_squared, softening_squared);
+            __m256 inv_dist = _mm256_rsqrt_ps(softened);
+            inv_dist = _mm256_mul_ps(inv_dist, _mm256_sub_ps(three_halves,
+                                                             _mm256_mul_ps(_mm256_mul_ps(half, softened),
+                                                                           _mm256_mul_ps(inv_dist, inv_dist))));
+            __m256 force = _mm256_mul_ps(_mm256_set1_ps(gravity_constant * sources.mass[j]),
+                                         _mm256_mul_ps(inv_dist, _mm256_mul_ps(inv_dist, inv_dist)));
+            force = _mm256_and_ps(force, _mm256_cmp_ps(dist_squared, zero, _CMP_GT_OQ));
+            sum_x = _mm256_add_ps(sum_x, _mm256_mul_ps(force, dx));
+            sum_y = _mm256_add_ps(sum_y, _mm256_mul_ps(force, dy));
+        }
+        _mm256_storeu_ps(ax + i, sum_x);
+        _mm256_storeu_ps(ay + i, sum_y);
+    }
+    return i;
+}
+
+static bool cpu_has_avx2() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    // AVX state must also be enabled by the OS, or the first ymm instruction faults.
+    __cpuid(info, 1);
+    bool os_saves_avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    return os_saves_avx && (info[1] & (1 << 5));
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+struct KernelChoice {
+    GravityKernel kernel;
+    const char *name;
+};
+
+static KernelChoice select_kernel() {
+#ifdef GRAVITY_KERNEL_X86
+    if (cpu_has_avx2())
+        return {gravity_avx2, "AVX2"};
+    return {gravity_sse, "SSE"};
+#else
+    return {gravity_scalar, "scalar"};
+#endif
+}
+
+static const KernelChoice &kernel_choice() {
+    static const KernelChoice choice = select_kernel();
+    return choice;
+}
+
+void accumulate_gravity(const GravityBodies &receivers, const GravityBodies &sources,
+                        float gravity_constant, float softening, std::vector<float> &ax, std::vector<float> &ay) {
+    ax.resize(receivers.size());
+    ay.resize(receivers.size());
+    if (receivers.size() == 0)
+        return;
+    accumulate_gravity(receivers, sources, gravity_constant, softening, ax.data(), ay.data(), 0, receivers.size());
+}
+
+void accumulate_gravity(const GravityBodies &receivers, const GravityBodies &sources,
+                        float gravity_constant, float softening, float *ax, float *ay, size_t begin, size_t end) {
+    size_t done = kernel_choice().kernel(receivers, sources, gravity_constant, softening, ax, ay, begin, end);
+    gravity_scalar_range(receivers, sources, gravity_constant, softening, ax, ay, done, end);
+}
+
+const char *gravity_kernel_name() {
+    return kernel_choice().name;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Structure-of-arrays copy of the Motion fields the gravity kernel reads, so a SIMD lane per body
+// loads contiguous floats instead of striding over whole Motion structs.
+struct GravityBodies {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> mass;
+
+    void clear() {
+        x.clear();
+        y.clear();
+        mass.clear();
+    }
+
+    void push_back(float px, float py, float m) {
+        x.push_back(px);
+        y.push_back(py);
+        mass.push_back(m);
+    }
+
+    size_t size() const {
+        return x.size();
+    }
+};
+
+// Writes into ax/ay the acceleration every receiver feels from every source, Plummer-softened by
+// `softening`. Pairs at zero distance are skipped, which is how a receiver that is also a source
+// excludes itself.
+//
+// The vector paths use rsqrt plus one Newton-Raphson step in place of normalize() and a divide. Each
+// pair contribution is within 1e-5 relative of the scalar get_gravity_effect, so a summed acceleration
+// is within 1e-5 of the sum of its contributions' magnitudes.
+void accumulate_gravity(const GravityBodies &receivers, const GravityBodies &sources,
+                        float gravity_constant, float softening, std::vector<float> &ax, std::vector<float> &ay);
+
+// Same for receivers [begin, end) only, writing ax[i]/ay[i] in place; concurrent calls on disjoint
+// ranges are safe. A receiver's result depends only on whether it falls in a full vector, so ranges
+// that start on a multiple of 8 give the same bits as one call over everything.
+void accumulate_gravity(const GravityBodies &receivers, const GravityBodies &sources,
+                        float gravity_constant, float softening, float *ax, float *ay, size_t begin, size_t end);
+
+// Instruction set chosen by CPUID at startup: "AVX2", "SSE" or "scalar".
+const char *gravity_kernel_name();
@@ -33,8 +33,11 @@ int main() {
         float elapsed_ms = (float) (std::chrono::duration_cast<std::chrono::microseconds>(now - t)).count() / 1000;
         t = now;
         world_system.step(elapsed_ms);
-        physics_system.step(elapsed_ms);
-        world_system.handle_collisions();
+        int physics_steps = physics_system.begin_frame(elapsed_ms);
+        for (int i = 0; i < physics_steps; i++) {
+            physics_system.step(PHYSICS_STEP_MS);
+            world_system.handle_collisions();
+        }
         camera_system.step(elapsed_ms);
         render_system.draw(elapsed_ms);
 
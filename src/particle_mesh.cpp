@@ -0,0 +1,174 @@
+#include "particle_mesh.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Rows or columns transformed per chunk of work; one is a few microseconds, too little to share alone.
+const size_t FFT_LINES_PER_CHUNK = 16;
+
+static vec2 pull(vec2 dp, float mass, float gravity_constant, float softening) {
+    float softened = dot(dp, dp) + softening * softening;
+    if (softened == 0.f)
+        return {0.f, 0.f};
+    return (gravity_constant * mass) / (softened * sqrt(softened)) * dp;
+}
+
+ParticleMesh::ParticleMesh(vec2 centre, vec2 size, float cell_size) :
+        origin(centre - size / 2.f),
+        cell_size(cell_size),
+        nodes(std::max(2, (int) std::ceil(std::max(size.x, size.y) / cell_size) + 1)),
+        padded(1) {
+    while (padded < 2 * nodes)
+        padded *= 2;
+    int bits = 0;
+    while ((1 << bits) < padded)
+        bits++;
+    bit_reversed.resize(padded);
+    for (int i = 0; i < padded; i++) {
+        int reversed = 0;
+        for (int b = 0; b < bits; b++)
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        bit_reversed[i] = reversed;
+    }
+    twiddles.resize(padded / 2);
+    for (int k = 0; k < padded / 2; k++)
+        twiddles[k] = std::polar(1.f, -2.f * (float) M_PI * k / padded);
+}
+
+// In-place iterative radix-2 transform of `padded` values; the inverse is left unscaled.
+void ParticleMesh::fft(std::complex<float> *data, bool inverse) const {
+    for (int i = 0; i < padded; i++)
+        if (i < bit_reversed[i])
+            std::swap(data[i], data[bit_reversed[i]]);
+    for (int length = 2; length <= padded; length *= 2) {
+        int half = length / 2;
+        int stride = padded / length;
+        for (int start = 0; start < padded; start += length)
+            for (int k = 0; k < half; k++) {
+                std::complex<float> w = inverse ? std::conj(twiddles[k * stride]) : twiddles[k * stride];
+                std::complex<float> odd = data[start + k + half] * w;
+                data[start + k + half] = data[start + k] - odd;
+                data[start + k] += odd;
+            }
+    }
+}
+
+void ParticleMesh::transform(std::vector<std::complex<float>> &data, int rows, bool inverse,
+                             WorkerPool &workers) const {
+    auto transform_rows = [&](size_t begin, size_t end) {
+        for (size_t r = begin; r < end; r++)
+            fft(&data[r * padded], inverse);
+    };
+    auto transform_columns = [&](size_t begin, size_t end) {
+        std::vector<std::complex<float>> column(padded);
+        for (size_t c = begin; c < end; c++) {
+            for (int r = 0; r < padded; r++)
+                column[r] = data[r * padded + c];
+            fft(column.data(), inverse);
+            for (int r = 0; r < padded; r++)
+                data[r * padded + c] = column[r];
+        }
+    };
+    if (!inverse)
+        workers.parallel_for(rows, FFT_LINES_PER_CHUNK, transform_rows);
+    workers.parallel_for(padded, FFT_LINES_PER_CHUNK, transform_columns);
+    if (inverse)
+        workers.parallel_for(rows, FFT_LINES_PER_CHUNK, transform_rows);
+}
+
+// The pull of a unit mass on a node at each offset from it, wrapped around the padded grid. Offsets
+// beyond the grid never occur between two nodes and are left at zero. The inverse transform's 1 / n^2
+// is folded in here.
+void ParticleMesh::build_kernel(WorkerPool &workers) {
+    kernel.assign((size_t) padded * padded, {0.f, 0.f});
+    for (int r = 0; r < padded; r++)
+        for (int c = 0; c < padded; c++) {
+            int dx = c < padded / 2 ? c : c - padded;
+            int dy = r < padded / 2 ? r : r - padded;
+            if (std::abs(dx) >= nodes || std::abs(dy) >= nodes)
+                continue;
+            vec2 a = pull(-cell_size * vec2(dx, dy), 1.f, gravity_constant, softening);
+            kernel[(size_t) r * padded + c] = {a.x, a.y};
+        }
+    transform(kernel, padded, false, workers);
+    float scale = 1.f / ((float) padded * padded);
+    for (std::complex<float> &k: kernel)
+        k *= scale;
+}
+
+bool ParticleMesh::locate(vec2 p, int &column, int &row, vec2 &fraction) const {
+    vec2 cell = (p - origin) / cell_size;
+    // Also rejects NaN.
+    if (!(cell.x >= 0.f && cell.y >= 0.f && cell.x < nodes - 1 && cell.y < nodes - 1))
+        return false;
+    column = (int) cell.x;
+    row = (int) cell.y;
+    fraction = cell - vec2(column, row);
+    return true;
+}
+
+void ParticleMesh::build(const std::vector<vec2> &positions, const std::vector<float> &masses,
+                         float gravity_constant, float softening, WorkerPool &workers) {
+    if (gravity_constant != this->gravity_constant || softening != this->softening) {
+        this->gravity_constant = gravity_constant;
+        this->softening = softening;
+        build_kernel(workers);
+    }
+
+    grid.assign((size_t) padded * padded, {0.f, 0.f});
+    outside_positions.clear();
+    outside_masses.clear();
+    mesh_mass = 0.f;
+    vec2 moment(0.f, 0.f);
+    for (size_t k = 0; k < positions.size(); k++) {
+        int c, r;
+        vec2 f;
+        if (!locate(positions[k], c, r, f)) {
+            outside_positions.push_back(positions[k]);
+            outside_masses.push_back(masses[k]);
+            continue;
+        }
+        size_t i = (size_t) r * padded + c;
+        float m = masses[k];
+        grid[i] += m * (1.f - f.x) * (1.f - f.y);
+        grid[i + 1] += m * f.x * (1.f - f.y);
+        grid[i + padded] += m * (1.f - f.x) * f.y;
+        grid[i + padded + 1] += m * f.x * f.y;
+        mesh_mass += m;
+        moment += m * positions[k];
+    }
+    mesh_centre = mesh_mass > 0.f ? moment / mesh_mass : vec2(0.f, 0.f);
+
+    accelerations.assign((size_t) nodes * nodes, {0.f, 0.f});
+    if (mesh_mass == 0.f)
+        return;
+    transform(grid, nodes, false, workers);
+    workers.parallel_for(padded, FFT_LINES_PER_CHUNK, [&](size_t begin, size_t end) {
+        for (size_t i = begin * padded; i < end * padded; i++)
+            grid[i] *= kernel[i];
+    });
+    // The density is real, so x and y come back as the real and imaginary parts of one transform.
+    transform(grid, nodes, true, workers);
+    for (int r = 0; r < nodes; r++)
+        for (int c = 0; c < nodes; c++) {
+            std::complex<float> a = grid[(size_t) r * padded + c];
+            accelerations[(size_t) r * nodes + c] = {a.real(), a.imag()};
+        }
+}
+
+vec2 ParticleMesh::acceleration(vec2 p) const {
+    vec2 total(0.f, 0.f);
+    int c, r;
+    vec2 f;
+    if (locate(p, c, r, f)) {
+        size_t i = (size_t) r * nodes + c;
+        vec2 bottom = mix(accelerations[i], accelerations[i + 1], f.x);
+        vec2 top = mix(accelerations[i + nodes], accelerations[i + nodes + 1], f.x);
+        total = mix(bottom, top, f.y);
+    } else if (mesh_mass > 0.f) {
+        total = pull(mesh_centre - p, mesh_mass, gravity_constant, softening);
+    }
+    for (size_t k = 0; k < outside_positions.size(); k++)
+        total += pull(outside_positions[k] - p, outside_masses[k], gravity_constant, softening);
+    return total;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <complex>
+#include <vector>
+
+#include "common.hpp"
+#include "worker_pool.hpp"
+
+// Particle-mesh gravity for very many sources. Masses are deposited cloud-in-cell onto the nodes of a grid,
+// convolved with the softened pull of a unit mass by FFT, and the acceleration is interpolated back with
+// the same weights, so a source exerts no net pull on itself. The grid is zero-padded to twice its size,
+// which keeps the far side of the scene from wrapping around. Pulls are smoothed over about two cells; a
+// source needing better than that has to be summed separately. Sources and receivers outside the grid
+// are handled exactly and by the monopole of the mesh respectively.
+class ParticleMesh {
+    vec2 origin;
+    float cell_size;
+    // Nodes per side, and the padded transform size, a power of two at least twice that.
+    int nodes;
+    int padded;
+    float gravity_constant = 0.f;
+    float softening = -1.f;
+
+    // Transform of the pull of a unit mass, x in the real part and y in the imaginary one, for every
+    // node offset; rebuilt when the constants change.
+    std::vector<std::complex<float>> kernel;
+    std::vector<std::complex<float>> twiddles;
+    std::vector<int> bit_reversed;
+
+    std::vector<std::complex<float>> grid;
+    // Acceleration at each node from the deposited masses.
+    std::vector<vec2> accelerations;
+    float mesh_mass = 0.f;
+    vec2 mesh_centre = {0.f, 0.f};
+    std::vector<vec2> outside_positions;
+    std::vector<float> outside_masses;
+
+    void fft(std::complex<float> *data, bool inverse) const;
+
+    // Row FFTs over rows [0, rows), then column FFTs over every column, or the reverse when inverse. Rows
+    // past `rows` are zero going forward and unused going back, so they are skipped.
+    void transform(std::vector<std::complex<float>> &data, int rows, bool inverse, WorkerPool &workers) const;
+
+    void build_kernel(WorkerPool &workers);
+
+    // Lower-left node of p's cell and p's offset into it, in cells; false when the cell is off the grid.
+    bool locate(vec2 p, int &column, int &row, vec2 &fraction) const;
+
+public:
+    ParticleMesh(vec2 centre, vec2 size, float cell_size);
+
+    void build(const std::vector<vec2> &positions, const std::vector<float> &masses, float gravity_constant,
+               float softening, WorkerPool &workers);
+
+    // Acceleration at p from every source given to build(). Safe to call concurrently.
+    vec2 acceleration(vec2 p) const;
+};
@@ -1,94 +1,833 @@
 #include "physics_system.hpp"
+#include <algorithm>
 #include <cmath>
 #include "world_system.hpp"
 
 using namespace glm;
 
-const float G = 10000.f;
-
 PhysicsSystem physics_system;
 
-vec2 get_gravity_effect(Motion &motion, Entity &entity) {
+// Re-evaluates attractor membership only for entities whose Motion was written, e.g. a mass change through
+// registry.motions.get(), or whose IgnorePhysics tag came or went since the last call. Then collects this
+// step's attractor slots from the Attractor tags, in motion order.
+void PhysicsSystem::update_attractors() {
+    auto &motion_container = registry.motions;
+    auto reevaluate = [&](Entity e) {
+        if (!motion_container.has(e))
+            return;
+        bool attracts = motion_container.peek(e).mass >= MIN_ATTRACTOR_MASS && !registry.ignore_physics.has(e);
+        if (attracts && !registry.attractors.has(e)) registry.attractors.emplace(e);
+        if (!attracts && registry.attractors.has(e)) registry.attractors.remove(e);
+    };
+    motion_container.each_changed_since(attractor_seen_tick, [&](Entity e, const Motion &) { reevaluate(e); });
+    for (Entity e: registry.ignore_physics.changed)
+        reevaluate(e);
+    registry.ignore_physics.changed.clear();
+    attractor_seen_tick = registry.advance_tick();
+
+    attractor_slots.clear();
+    registry.attractors.each_entity([&](Entity e) {
+        if (motion_container.has(e))
+            attractor_slots.push_back((uint) motion_container.index_of(e));
+    });
+    std::sort(attractor_slots.begin(), attractor_slots.end());
+    source_index.assign(motion_container.size(), -1);
+    for (size_t k = 0; k < attractor_slots.size(); k++)
+        source_index[attractor_slots[k]] = (int) k;
+}
+
+// Plummer-softened acceleration towards a source of the given mass at offset dp.
+static vec2 gravity_pull(vec2 dp, float mass) {
+    float dist_squared = dot(dp, dp) + GRAVITY_SOFTENING * GRAVITY_SOFTENING;
+    float force_magnitude = (G * mass) / dist_squared;
+    vec2 force_direction = dp / sqrt(dist_squared);
+    return force_magnitude * force_direction;
+}
+
+// Bodies before motion i have already moved this step and pull from where they are now, the rest from
+// where they started. Reading the latter from attractor_positions leaves body i racing with no other.
+vec2 PhysicsSystem::get_gravity_effect(uint i) {
     vec2 total_gravity(0.0f, 0.0f);
-    if (registry.ignore_physics.has(entity))
+    auto &motion_container = registry.motions;
+    if (registry.ignore_physics.has(motion_container.entities[i]))
         return total_gravity;
 
+    const Motion &motion = motion_container.components[i];
+    for (size_t k = 0; k < attractor_slots.size(); k++) {
+        uint j = attractor_slots[k];
+        if (j == i)
+            continue;
+        const Motion &other_motion = motion_container.components[j];
+        vec2 other_position = j < i ? other_motion.position : attractor_positions[k];
+        total_gravity += gravity_pull(other_position - motion.position, other_motion.mass);
+    }
+
+    return total_gravity;
+}
+
+void PhysicsSystem::build_gravity_sources() {
     auto &motion_container = registry.motions;
-    for (uint j = 0; j < motion_container.size(); j++) {
-        Entity &other_entity = motion_container.entities[j];
-        Motion &other_motion = motion_container.components[j];
-        if (other_entity == entity || registry.ignore_physics.has(other_entity))
+    source_positions.clear();
+    source_masses.clear();
+    for (uint j: attractor_slots) {
+        source_positions.push_back(motion_container.components[j].position);
+        source_masses.push_back(motion_container.components[j].mass);
+    }
+    gravity_tree.build(source_positions, source_masses);
+}
+
+void PhysicsSystem::build_gravity_bodies() {
+    auto &motion_container = registry.motions;
+    gravity_receivers.clear();
+    gravity_sources.clear();
+    for (uint i = 0; i < motion_container.size(); i++) {
+        const Motion &motion = motion_container.components[i];
+        gravity_receivers.push_back(motion.position.x, motion.position.y, motion.mass);
+    }
+    for (uint j: attractor_slots) {
+        const Motion &motion = motion_container.components[j];
+        gravity_sources.push_back(motion.position.x, motion.position.y, motion.mass);
+    }
+    gravity_ax.resize(gravity_receivers.size());
+    gravity_ay.resize(gravity_receivers.size());
+    parallel_for(gravity_receivers.size(), [&](size_t begin, size_t end) {
+        accumulate_gravity(gravity_receivers, gravity_sources, G, GRAVITY_SOFTENING, gravity_ax.data(),
+                           gravity_ay.data(), begin, end);
+    });
+}
+
+// Caches the attractors on rails in the field, and snapshots every attractor as a source.
+void PhysicsSystem::update_gravity_field() {
+    auto &motion_container = registry.motions;
+    field_orbits.clear();
+    field_masses.clear();
+    dynamic_sources.clear();
+    source_positions.clear();
+    source_masses.clear();
+    for (size_t k = 0; k < attractor_slots.size(); k++) {
+        Entity entity = motion_container.entities[attractor_slots[k]];
+        const Motion &motion = motion_container.components[attractor_slots[k]];
+        source_positions.push_back(motion.position);
+        source_masses.push_back(motion.mass);
+        if (registry.angular_motions.has(entity)) {
+            field_orbits.push_back(registry.angular_motions.peek(entity));
+            field_masses.push_back(motion.mass);
+        } else {
+            dynamic_sources.push_back((int) k);
+        }
+    }
+    gravity_field.update(field_orbits, field_masses, G, GRAVITY_SOFTENING);
+    gravity_field.set_time(simulation_time);
+}
+
+// Snapshots every attractor as a source and picks out the ones summed exactly.
+void PhysicsSystem::update_particle_mesh() {
+    auto &motion_container = registry.motions;
+    exact_sources.clear();
+    source_positions.clear();
+    source_masses.clear();
+    for (size_t k = 0; k < attractor_slots.size(); k++) {
+        const Motion &motion = motion_container.components[attractor_slots[k]];
+        source_positions.push_back(motion.position);
+        source_masses.push_back(motion.mass);
+        if (motion.mass >= PARTICLE_MESH_EXACT_MASS)
+            exact_sources.push_back((int) k);
+    }
+}
+
+// Deposits the sources at their current source_positions, except those summed exactly, and solves.
+void PhysicsSystem::build_particle_mesh() {
+    mesh_positions.clear();
+    mesh_masses.clear();
+    size_t next_exact = 0;
+    for (size_t k = 0; k < source_positions.size(); k++) {
+        if (next_exact < exact_sources.size() && exact_sources[next_exact] == (int) k) {
+            next_exact++;
+            continue;
+        }
+        mesh_positions.push_back(source_positions[k]);
+        mesh_masses.push_back(source_masses[k]);
+    }
+    particle_mesh.build(mesh_positions, mesh_masses, G, GRAVITY_SOFTENING, workers);
+}
+
+vec2 PhysicsSystem::get_gravity(uint i) {
+    Motion &motion = registry.motions.components[i];
+    Entity &entity = registry.motions.entities[i];
+    if (gravity_solver == GRAVITY_SOLVER::BARNES_HUT) {
+        if (registry.ignore_physics.has(entity))
+            return {0.f, 0.f};
+        return gravity_tree.acceleration(motion.position, source_index[i], barnes_hut_theta, G, GRAVITY_SOFTENING);
+    }
+    if (gravity_solver == GRAVITY_SOLVER::SIMD) {
+        if (registry.ignore_physics.has(entity))
+            return {0.f, 0.f};
+        // Precomputed at the start-of-step position; a body that has sub-stepped away sums directly.
+        if (motion.position == vec2(gravity_receivers.x[i], gravity_receivers.y[i]))
+            return {gravity_ax[i], gravity_ay[i]};
+        vec2 total_gravity(0.f, 0.f);
+        for (size_t k = 0; k < gravity_sources.size(); k++)
+            if ((int) k != source_index[i])
+                total_gravity += gravity_pull(vec2(gravity_sources.x[k], gravity_sources.y[k]) - motion.position,
+                                              gravity_sources.mass[k]);
+        return total_gravity;
+    }
+    if (gravity_solver == GRAVITY_SOLVER::FIELD) {
+        if (registry.ignore_physics.has(entity))
+            return {0.f, 0.f};
+        vec2 total_gravity = gravity_field.acceleration(motion.position);
+        for (int k: dynamic_sources)
+            if (k != source_index[i])
+                total_gravity += gravity_pull(source_positions[k] - motion.position, source_masses[k]);
+        return total_gravity;
+    }
+    if (gravity_solver == GRAVITY_SOLVER::PARTICLE_MESH) {
+        if (registry.ignore_physics.has(entity))
+            return {0.f, 0.f};
+        // The mesh still holds a source where it was deposited, so one that has sub-stepped away from there
+        // would feel its own pull through it; such a source sums directly instead.
+        int self = source_index[i];
+        if (self >= 0 && source_masses[self] < PARTICLE_MESH_EXACT_MASS && motion.position != source_positions[self]) {
+            vec2 total_gravity(0.f, 0.f);
+            for (size_t k = 0; k < source_positions.size(); k++)
+                if ((int) k != self)
+                    total_gravity += gravity_pull(source_positions[k] - motion.position, source_masses[k]);
+            return total_gravity;
+        }
+        vec2 total_gravity = particle_mesh.acceleration(motion.position);
+        for (int k: exact_sources)
+            if (k != source_index[i])
+                total_gravity += gravity_pull(source_positions[k] - motion.position, source_masses[k]);
+        return total_gravity;
+    }
+    return get_gravity_effect(i);
+}
+
+// Snapshots the start-of-step state of the bodies the whole-system integrators advance, and of the sources.
+void PhysicsSystem::gather_bodies() {
+    auto &motion_container = registry.motions;
+    body_slots.clear();
+    body_boosts.clear();
+    body_feels_gravity.clear();
+    body_source.clear();
+    start_positions.clear();
+    start_velocities.clear();
+    source_positions.clear();
+    source_masses.clear();
+    source_orbits.clear();
+    source_body.assign(attractor_slots.size(), -1);
+    for (uint j: attractor_slots) {
+        Entity entity = motion_container.entities[j];
+        source_positions.push_back(motion_container.components[j].position);
+        source_masses.push_back(motion_container.components[j].mass);
+        source_orbits.push_back(registry.angular_motions.has(entity) ? registry.angular_motions.peek(entity)
+                                                                     : AngularMotion());
+    }
+    for (uint i = 0; i < motion_container.size(); i++) {
+        if (motion_on_rails[i])
             continue;
+        const Motion &motion = motion_container.components[i];
+        if (source_index[i] >= 0)
+            source_body[source_index[i]] = (int) body_slots.size();
+        body_slots.push_back(i);
+        body_boosts.push_back(motion_boosts[i]);
+        body_feels_gravity.push_back(!registry.ignore_physics.has(motion_container.entities[i]));
+        body_source.push_back(source_index[i]);
+        start_positions.push_back(motion.position);
+        start_velocities.push_back(motion.velocity);
+    }
+}
+
+// Gravity on every gathered body with the bodies at the given positions, or only on the bodies listed in
+// `active`, leaving the others' entries as they were. Attractors that are themselves bodies are moved to
+// their given positions too, so a body never meets its own mass at a nonzero distance; attractors on rails
+// are moved along their orbits to the given time.
+void PhysicsSystem::evaluate_gravity(const std::vector<vec2> &positions, double seconds, std::vector<vec2> &out,
+                                     const std::vector<uint> *active) {
+    for (size_t k = 0; k < source_body.size(); k++)
+        source_positions[k] = source_body[k] >= 0 ? positions[source_body[k]] : source_orbits[k].position_at(seconds);
 
-        vec2 dp = other_motion.position - motion.position;
-        float dist_squared = dot(dp, dp);
-        float force_magnitude = (G * other_motion.mass) / dist_squared;
-        vec2 force_direction = normalize(dp);
-        vec2 gravitational_force = force_magnitude * force_direction;
-        total_gravity += gravitational_force;
+    size_t count = active ? active->size() : positions.size();
+    auto body = [&](size_t r) { return active ? (size_t) (*active)[r] : r; };
+    if (active)
+        out.resize(positions.size());
+    else
+        out.assign(positions.size(), {0.f, 0.f});
+    if (gravity_solver == GRAVITY_SOLVER::BARNES_HUT) {
+        gravity_tree.build(source_positions, source_masses);
+        parallel_for(count, [&](size_t begin, size_t end) {
+            for (size_t r = begin; r < end; r++) {
+                size_t b = body(r);
+                out[b] = !body_feels_gravity[b] ? vec2(0.f, 0.f) :
+                         gravity_tree.acceleration(positions[b], body_source[b], barnes_hut_theta, G,
+                                                   GRAVITY_SOFTENING);
+            }
+        });
+    } else if (gravity_solver == GRAVITY_SOLVER::SIMD) {
+        gravity_receivers.clear();
+        gravity_sources.clear();
+        for (size_t r = 0; r < count; r++)
+            gravity_receivers.push_back(positions[body(r)].x, positions[body(r)].y, 0.f);
+        for (size_t k = 0; k < source_positions.size(); k++)
+            gravity_sources.push_back(source_positions[k].x, source_positions[k].y, source_masses[k]);
+        gravity_ax.resize(count);
+        gravity_ay.resize(count);
+        parallel_for(count, [&](size_t begin, size_t end) {
+            accumulate_gravity(gravity_receivers, gravity_sources, G, GRAVITY_SOFTENING, gravity_ax.data(),
+                               gravity_ay.data(), begin, end);
+            for (size_t r = begin; r < end; r++) {
+                size_t b = body(r);
+                out[b] = body_feels_gravity[b] ? vec2(gravity_ax[r], gravity_ay[r]) : vec2(0.f, 0.f);
+            }
+        });
+    } else if (gravity_solver == GRAVITY_SOLVER::FIELD) {
+        gravity_field.set_time(seconds);
+        parallel_for(count, [&](size_t begin, size_t end) {
+            for (size_t r = begin; r < end; r++) {
+                size_t b = body(r);
+                out[b] = {0.f, 0.f};
+                if (!body_feels_gravity[b])
+                    continue;
+                out[b] = gravity_field.acceleration(positions[b]);
+                for (int k: dynamic_sources)
+                    if (k != body_source[b])
+                        out[b] += gravity_pull(source_positions[k] - positions[b], source_masses[k]);
+            }
+        });
+    } else if (gravity_solver == GRAVITY_SOLVER::PARTICLE_MESH) {
+        build_particle_mesh();
+        parallel_for(count, [&](size_t begin, size_t end) {
+            for (size_t r = begin; r < end; r++) {
+                size_t b = body(r);
+                out[b] = {0.f, 0.f};
+                if (!body_feels_gravity[b])
+                    continue;
+                out[b] = particle_mesh.acceleration(positions[b]);
+                for (int k: exact_sources)
+                    if (k != body_source[b])
+                        out[b] += gravity_pull(source_positions[k] - positions[b], source_masses[k]);
+            }
+        });
+    } else {
+        parallel_for(count, [&](size_t begin, size_t end) {
+            for (size_t r = begin; r < end; r++) {
+                size_t b = body(r);
+                out[b] = {0.f, 0.f};
+                if (!body_feels_gravity[b])
+                    continue;
+                for (size_t k = 0; k < source_positions.size(); k++)
+                    if ((int) k != body_source[b])
+                        out[b] += gravity_pull(source_positions[k] - positions[b], source_masses[k]);
+            }
+        });
     }
+}
 
-    return total_gravity;
+// How many equal sub-steps a body with this velocity and acceleration needs, so that none changes its
+// velocity by more than SUBSTEP_TOLERANCE of its speed plus sqrt(softening * |a|). The second term, about
+// the speed the acceleration builds over a softening length, keeps a body at rest from needing infinitely
+// many. Bodies away from close encounters get one.
+static int substep_count(vec2 velocity, vec2 acceleration, float step_seconds) {
+    float a = length(acceleration);
+    float substep_seconds = SUBSTEP_TOLERANCE * (length(velocity) + sqrt(GRAVITY_SOFTENING * a)) / a;
+    // Also catches a == 0 and NaN.
+    if (!(substep_seconds < step_seconds))
+        return 1;
+    return std::min(MAX_SUBSTEPS, (int) std::ceil(step_seconds / substep_seconds));
+}
+
+// The block level whose step, a power-of-two fraction of step_seconds, is as fine as substep_count() asks.
+static int block_level(vec2 velocity, vec2 acceleration, float step_seconds) {
+    int substeps = substep_count(velocity, acceleration, step_seconds);
+    int level = 0;
+    while (level < MAX_BLOCK_LEVEL && (1 << level) < substeps)
+        level++;
+    return level;
+}
+
+// Advances the gathered bodies by one step. SpeedUp scales how far a body travels, not its velocity,
+// so each drift uses boost * velocity.
+void PhysicsSystem::integrate(double t0, float dt) {
+    size_t n = body_slots.size();
+    stage_positions.resize(n);
+    stage_velocities.resize(n);
+    switch (integrator) {
+        case INTEGRATOR::LEAPFROG:
+            // Drift-kick-drift: one gravity evaluation per step, at the midpoint.
+            parallel_for(n, [&](size_t begin, size_t end) {
+                for (size_t b = begin; b < end; b++)
+                    stage_positions[b] = start_positions[b] + 0.5f * dt * body_boosts[b] * start_velocities[b];
+            });
+            evaluate_gravity(stage_positions, t0 + 0.5 * dt, accelerations);
+            parallel_for(n, [&](size_t begin, size_t end) {
+                for (size_t b = begin; b < end; b++) {
+                    stage_velocities[b] = start_velocities[b] + dt * accelerations[b];
+                    stage_positions[b] += 0.5f * dt * body_boosts[b] * stage_velocities[b];
+                }
+            });
+            break;
+        case INTEGRATOR::VELOCITY_VERLET:
+            // Kick-drift-kick. The start acceleration is re-evaluated rather than carried over from the
+            // previous step, because sources on rails and membership can change between steps.
+            evaluate_gravity(start_positions, t0, accelerations);
+            parallel_for(n, [&](size_t begin, size_t end) {
+                for (size_t b = begin; b < end; b++) {
+                    stage_velocities[b] = start_velocities[b] + 0.5f * dt * accelerations[b];
+                    stage_positions[b] = start_positions[b] + dt * body_boosts[b] * stage_velocities[b];
+                }
+            });
+            evaluate_gravity(stage_positions, t0 + dt, accelerations);
+            parallel_for(n, [&](size_t begin, size_t end) {
+                for (size_t b = begin; b < end; b++)
+                    stage_velocities[b] += 0.5f * dt * accelerations[b];
+            });
+            break;
+        case INTEGRATOR::RK4:
+            position_sum.assign(n, {0.f, 0.f});
+            velocity_sum.assign(n, {0.f, 0.f});
+            stage_positions = start_positions;
+            stage_velocities = start_velocities;
+            for (int stage = 0; stage < 4; stage++) {
+                const float weights[] = {1.f, 2.f, 2.f, 1.f};
+                const float offsets[] = {0.5f, 0.5f, 1.f, 0.f};
+                const float times[] = {0.f, 0.5f, 0.5f, 1.f};
+                evaluate_gravity(stage_positions, t0 + times[stage] * dt, accelerations);
+                parallel_for(n, [&](size_t begin, size_t end) {
+                    for (size_t b = begin; b < end; b++) {
+                        position_sum[b] += weights[stage] * body_boosts[b] * stage_velocities[b];
+                        velocity_sum[b] += weights[stage] * accelerations[b];
+                        vec2 stage_velocity = stage_velocities[b];
+                        stage_velocities[b] = start_velocities[b] + offsets[stage] * dt * accelerations[b];
+                        stage_positions[b] = start_positions[b] + offsets[stage] * dt * body_boosts[b] * stage_velocity;
+                    }
+                });
+            }
+            parallel_for(n, [&](size_t begin, size_t end) {
+                for (size_t b = begin; b < end; b++) {
+                    stage_positions[b] = start_positions[b] + dt / 6.f * position_sum[b];
+                    stage_velocities[b] = start_velocities[b] + dt / 6.f * velocity_sum[b];
+                }
+            });
+            break;
+        case INTEGRATOR::BLOCK_TIMESTEPS:
+            integrate_blocks(t0, dt);
+            break;
+        default:
+            assert(false && "Semi-implicit Euler runs in place in step()");
+            break;
+    }
+
+    auto &motion_container = registry.motions;
+    parallel_for(n, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; b++) {
+            Motion &motion = motion_container.components[body_slots[b]];
+            motion.position = stage_positions[b];
+            motion.velocity = stage_velocities[b];
+        }
+    });
+}
+
+// Block timesteps over one step, cut into 2^MAX_BLOCK_LEVEL ticks. A body on level l kicks, drifts and
+// kicks every 2^(MAX_BLOCK_LEVEL - l) ticks, and only bodies whose step ends at a tick have their gravity
+// evaluated there; the rest have only drifted, so their positions are predicted. Every body drifts to
+// each such tick, and nothing happens between them. A body may move to a finer level at the end of any of
+// its steps, and to a coarser one only where that level's steps line up; all are in sync at the end.
+void PhysicsSystem::integrate_blocks(double t0, float dt) {
+    size_t n = body_slots.size();
+    const int ticks = 1 << MAX_BLOCK_LEVEL;
+    float tick_seconds = dt / ticks;
+    stage_positions = start_positions;
+    stage_velocities = start_velocities;
+    evaluate_gravity(stage_positions, t0, accelerations);
+    body_levels.resize(n);
+    parallel_for(n, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; b++)
+            body_levels[b] = block_level(stage_velocities[b], accelerations[b], dt);
+    });
+
+    int tick = 0;
+    while (tick < ticks) {
+        int finest = 0;
+        for (size_t b = 0; b < n; b++)
+            finest = std::max(finest, body_levels[b]);
+        int from = tick;
+        tick += ticks >> finest;
+        parallel_for(n, [&](size_t begin, size_t end) {
+            for (size_t b = begin; b < end; b++) {
+                int stride = ticks >> body_levels[b];
+                if (from % stride == 0)
+                    stage_velocities[b] += 0.5f * stride * tick_seconds * accelerations[b];
+                stage_positions[b] += (tick - from) * tick_seconds * body_boosts[b] * stage_velocities[b];
+            }
+        });
+
+        active_bodies.clear();
+        for (size_t b = 0; b < n; b++)
+            if (tick % (ticks >> body_levels[b]) == 0)
+                active_bodies.push_back((uint) b);
+        evaluate_gravity(stage_positions, t0 + (double) tick * tick_seconds, accelerations, &active_bodies);
+        parallel_for(active_bodies.size(), [&](size_t begin, size_t end) {
+            for (size_t r = begin; r < end; r++) {
+                uint b = active_bodies[r];
+                int stride = ticks >> body_levels[b];
+                stage_velocities[b] += 0.5f * stride * tick_seconds * accelerations[b];
+                int level = block_level(stage_velocities[b], accelerations[b], dt);
+                while (level < body_levels[b] && tick % (2 * stride) == 0) {
+                    body_levels[b]--;
+                    stride *= 2;
+                }
+                body_levels[b] = std::max(body_levels[b], level);
+            }
+        });
+    }
 }
 
-bool collides(Entity missileEn, const Motion &motion_missile, const Motion &motion_other) {
-    Mesh *missileMesh = registry.meshPtrs.get(missileEn);
+void PhysicsSystem::cycle_integrator() {
+    const char *names[] = {"semi-implicit Euler", "leapfrog", "velocity Verlet", "RK4", "block timesteps"};
+    integrator = (INTEGRATOR) (((int) integrator + 1) % (int) INTEGRATOR::INTEGRATOR_COUNT);
+    printf("Integrator = %s\n", names[(int) integrator]);
+}
+
+void PhysicsSystem::cycle_gravity_solver() {
+    const char *names[] = {"direct", "Barnes-Hut", "direct SIMD", "field cache", "particle mesh"};
+    gravity_solver = (GRAVITY_SOLVER) (((int) gravity_solver + 1) % (int) GRAVITY_SOLVER::SOLVER_COUNT);
+    if (gravity_solver == GRAVITY_SOLVER::SIMD)
+        printf("Gravity solver = %s (%s)\n", names[(int) gravity_solver], gravity_kernel_name());
+    else
+        printf("Gravity solver = %s\n", names[(int) gravity_solver]);
+}
+
+void PhysicsSystem::set_thread_count(unsigned int count) {
+    workers.set_thread_count(std::max(count, 1u));
+    printf("Physics threads = %u%s\n", workers.thread_count(), deterministic ? " (deterministic)" : "");
+}
+
+void PhysicsSystem::cycle_thread_count() {
+    unsigned int limit = std::max(std::thread::hardware_concurrency(), 1u);
+    unsigned int count = workers.thread_count();
+    set_thread_count(count >= limit ? 1 : std::min(count * 2, limit));
+}
+
+size_t PhysicsSystem::chunk_size(size_t count) const {
+    if (deterministic)
+        return PHYSICS_CHUNK_SIZE;
+    size_t per_thread = (count + workers.thread_count() - 1) / workers.thread_count();
+    return std::max((per_thread + 7) / 8 * 8, (size_t) 8);
+}
+
+void PhysicsSystem::parallel_for(size_t count, const std::function<void(size_t, size_t)> &f) {
+    workers.parallel_for(count, chunk_size(count), f);
+}
+
+int PhysicsSystem::begin_frame(float elapsed_ms) {
+    accumulator_ms += elapsed_ms;
+    int steps = (int) (accumulator_ms / PHYSICS_STEP_MS);
+    if (steps > MAX_PHYSICS_STEPS_PER_FRAME) {
+        steps = MAX_PHYSICS_STEPS_PER_FRAME;
+        accumulator_ms = fmod(accumulator_ms, PHYSICS_STEP_MS) + steps * PHYSICS_STEP_MS;
+    }
+    accumulator_ms -= steps * PHYSICS_STEP_MS;
+    return steps;
+}
 
-    for (const ColoredVertex &vertex: missileMesh->vertices) {
-        vec2 vertexPosition = vec2(vertex.position.x, vertex.position.y);
-        vec2 dp = motion_missile.position + vertexPosition - motion_other.position;
-        double distSq = dot(dp, dp);
-        double radSq = pow(motion_other.radius, 2);
-        if (distSq < radSq)
-            return true;
+bool PhysicsSystem::interpolates(Entity entity) const {
+    return !registry.motions.changed_since(entity, interpolation_tick);
+}
+
+vec2 PhysicsSystem::render_position(Entity entity, const Motion &motion) const {
+    if (!interpolates(entity))
+        return motion.position;
+    float alpha = accumulator_ms / PHYSICS_STEP_MS;
+    return mix(motion.previous_position, motion.position, alpha);
+}
+
+float PhysicsSystem::render_angle(Entity entity, const Motion &motion) const {
+    if (!interpolates(entity))
+        return motion.angle;
+    float alpha = accumulator_ms / PHYSICS_STEP_MS;
+    // Headings come from atan2 and wrap at +-pi, so blend along the shorter arc.
+    float delta = remainder(motion.angle - motion.previous_angle, 2.f * (float) M_PI);
+    return motion.previous_angle + alpha * delta;
+}
+
+// Whether the missile's hull, placed by its scale and angle, touches the other body's circle.
+bool collides(const Mesh &mesh, const Motion &motion_missile, const Motion &motion_other) {
+    vec2 dp = motion_other.position - motion_missile.position;
+    vec2 scale = motion_missile.scale;
+    float reach = mesh.bounding_radius * max(abs(scale.x), abs(scale.y)) + motion_other.radius;
+    if (dot(dp, dp) >= reach * reach || mesh.hull_x.empty())
+        return false;
+
+    // Rotate the circle into the missile's frame instead of rotating every hull point out of it.
+    float c = cos(motion_missile.angle);
+    float s = sin(motion_missile.angle);
+    vec2 centre = {c * dp.x + s * dp.y, c * dp.y - s * dp.x};
+    float radius_squared = motion_other.radius * motion_other.radius;
+
+    // Branch-free over the hull edges so the loop can vectorize: the closest point of each edge is tested
+    // against the circle, and the sign of each edge's cross product tells whether the centre is inside.
+    size_t edges = mesh.hull_x.size() - 1;
+    bool touches = false;
+    float min_cross = 0.f;
+    float max_cross = 0.f;
+    for (size_t i = 0; i < edges; i++) {
+        float ax = scale.x * mesh.hull_x[i] - centre.x;
+        float ay = scale.y * mesh.hull_y[i] - centre.y;
+        float ex = scale.x * mesh.hull_x[i + 1] - centre.x - ax;
+        float ey = scale.y * mesh.hull_y[i + 1] - centre.y - ay;
+        float t = min(max(-(ax * ex + ay * ey) / max(ex * ex + ey * ey, 1e-12f), 0.f), 1.f);
+        float px = ax + t * ex;
+        float py = ay + t * ey;
+        touches |= px * px + py * py < radius_squared;
+        float cross = ax * ey - ay * ex;
+        min_cross = min(min_cross, cross);
+        max_cross = max(max_cross, cross);
+    }
+    // Mirroring scales flip the winding, so inside means all crosses share a sign, either sign.
+    bool centre_inside = edges >= 3 && (min_cross >= 0.f || max_cross <= 0.f);
+    return touches || centre_inside;
+}
+
+// Fills motion_boosts and motion_on_rails from views driven by the few SpeedUp and AngularMotion
+// components, rather than probing both containers for every motion.
+void PhysicsSystem::join_motions() {
+    auto &motion_container = registry.motions;
+    motion_boosts.assign(motion_container.size(), 1.f);
+    motion_on_rails.assign(motion_container.size(), false);
+    registry.view<Motion, SpeedUp>().each([&](Entity entity, const Motion &, const SpeedUp &speed_up) {
+        motion_boosts[motion_container.index_of(entity)] = speed_up.boost;
+    });
+    registry.view<Motion, AngularMotion>().each([&](Entity entity, const Motion &, const AngularMotion &) {
+        motion_on_rails[motion_container.index_of(entity)] = true;
+    });
+}
+
+// Moves bodies on rails to where their orbit is at the clock's current time. Writes through components[]
+// like the integrators, so the motions are not stamped as changed and still interpolate.
+void PhysicsSystem::advance_rails() {
+    auto &motion_container = registry.motions;
+    registry.view<Motion, AngularMotion>().each([&](Entity entity, const Motion &, const AngularMotion &orbit) {
+        Motion &motion = motion_container.components[motion_container.index_of(entity)];
+        motion.position = orbit.position_at(simulation_time);
+        motion.velocity = orbit.velocity_at(simulation_time);
+    });
+}
+
+// Semi-implicit Euler for one body not on rails. Reads no other body's state except through get_gravity,
+// so bodies can advance concurrently.
+void PhysicsSystem::advance_body(uint i, float step_seconds) {
+    if (motion_on_rails[i])
+        return;
+    Motion &motion = registry.motions.components[i];
+    float speed_boost = motion_boosts[i];
+    vec2 total_gravity = get_gravity(i);
+    int substeps = substep_count(motion.velocity, total_gravity, step_seconds);
+    if (substeps == 1) {
+        motion.velocity += total_gravity * step_seconds;
+        motion.position += (motion.velocity) * step_seconds * speed_boost;
+        return;
+    }
+    // Semi-implicit Euler keeps velocity half a step behind position, so changing the step size alone
+    // would leave a velocity error of about a * dt / 2. Bring it level, take kick-drift-kick sub-steps,
+    // and drop it back half a step at the end; with one sub-step this reduces to the branch above.
+    float substep_seconds = step_seconds / substeps;
+    motion.velocity += total_gravity * (step_seconds / 2.f);
+    for (int s = 0; s < substeps; s++) {
+        motion.velocity += total_gravity * (substep_seconds / 2.f);
+        motion.position += motion.velocity * substep_seconds * speed_boost;
+        total_gravity = get_gravity(i);
+        motion.velocity += total_gravity * (substep_seconds / 2.f);
     }
-    return false;
+    motion.velocity -= total_gravity * (step_seconds / 2.f);
 }
 
 void PhysicsSystem::step(float elapsed_ms) {
+    auto &motion_container = registry.motions;
+    for (uint i = 0; i < motion_container.size(); i++) {
+        Motion &motion = motion_container.components[i];
+        motion.previous_position = motion.position;
+        motion.previous_angle = motion.angle;
+    }
+    interpolation_tick = registry.advance_tick();
+
     Phase &p = registry.phases.components[0];
     if (!p.simulation)
         return;
 
-    auto &motion_container = registry.motions;
     float step_seconds = elapsed_ms / 1000.f;
-    for (uint i = 0; i < motion_container.size(); i++) {
-        Motion &motion = motion_container.components[i];
-        Entity &entity = motion_container.entities[i];
-        float speed_boost = 1.0f;
-        if (registry.speed_up.has(entity)) {
-            speed_boost = registry.speed_up.get(entity).boost;
-        }
+    double start_seconds = simulation_time;
+    simulation_time += step_seconds;
+    update_attractors();
+    if (gravity_solver == GRAVITY_SOLVER::FIELD)
+        update_gravity_field();
+    else if (gravity_solver == GRAVITY_SOLVER::PARTICLE_MESH)
+        update_particle_mesh();
+    join_motions();
+    bool in_place = integrator == INTEGRATOR::SEMI_IMPLICIT_EULER;
+    if (!in_place)
+        gather_bodies();
+    else if (gravity_solver == GRAVITY_SOLVER::BARNES_HUT)
+        build_gravity_sources();
+    else if (gravity_solver == GRAVITY_SOLVER::SIMD)
+        build_gravity_bodies();
+    else if (gravity_solver == GRAVITY_SOLVER::PARTICLE_MESH)
+        build_particle_mesh();
+    if (in_place && gravity_solver == GRAVITY_SOLVER::DIRECT) {
+        // Direct Euler feels attractors mid-step, so they move first and in order; the remaining bodies
+        // only read them and run in parallel, with the same results as one pass in index order.
+        attractor_positions.clear();
+        for (uint j: attractor_slots)
+            attractor_positions.push_back(motion_container.components[j].position);
+        advance_rails();
+        for (uint j: attractor_slots)
+            advance_body(j, step_seconds);
+        parallel_for(motion_container.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                if (source_index[i] < 0)
+                    advance_body((uint) i, step_seconds);
+        });
+    } else if (in_place) {
+        advance_rails();
+        parallel_for(motion_container.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                advance_body((uint) i, step_seconds);
+        });
+    } else {
+        advance_rails();
+        integrate(start_seconds, step_seconds);
+    }
 
-        if (registry.angular_motions.has(entity)) {
-            Transform transform;
-            transform.rotate(step_seconds * motion.angle);
-            motion.position = mat2(transform.mat) * (motion.position - motion.velocity) + motion.velocity * speed_boost;
-        } else {
-            vec2 total_gravity = get_gravity_effect(motion, entity);
-            motion.velocity += total_gravity * step_seconds;
-            motion.position += (motion.velocity) * step_seconds * speed_boost;
-            if (registry.asteroids.has(entity))
+    parallel_for(motion_container.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            Motion &motion = motion_container.components[i];
+            if (motion_on_rails[i])
+                continue;
+            if (registry.asteroids.has(motion_container.entities[i]))
                 motion.angle += step_seconds * M_PI / 2.f;
             else if (dot(motion.velocity, motion.velocity) > 0)
                 motion.angle = atan2(motion.velocity.y, motion.velocity.x);
         }
+    });
+
+    detect_collisions();
+}
+
+// Earliest fraction of the step at which a circle starting at `offset` from the origin and moving by
+// `travel` comes within `reach` of it, or -1 if it never does.
+static float time_of_entry(vec2 offset, vec2 travel, float reach) {
+    float c = dot(offset, offset) - reach * reach;
+    if (c <= 0.f)
+        return 0.f;
+    float a = dot(travel, travel);
+    float b = dot(offset, travel);
+    float discriminant = b * b - a * c;
+    if (a == 0.f || b >= 0.f || discriminant < 0.f)
+        return -1.f;
+    float t = (-b - sqrt(discriminant)) / a;
+    return t <= 1.f ? t : -1.f;
+}
+
+static int collision_layer(Entity entity, const Motion &motion) {
+    if (registry.missiles.has(entity))
+        return LAYER_MISSILE;
+    if (motion.radius <= 0.f)
+        return 0;
+    if (registry.asteroids.has(entity))
+        return LAYER_ASTEROID;
+    if (registry.planets.has(entity))
+        return LAYER_PLANET;
+    if (registry.suns.has(entity))
+        return LAYER_SUN;
+    if (registry.wormholes.has(entity))
+        return LAYER_WORMHOLE;
+    return registry.ignore_physics.has(entity) ? 0 : LAYER_BODY;
+}
+
+// Appends the earliest contact of motion i with a layer on its COLLISION_MATRIX row, if any. Only reads
+// shared state, so movers can be swept concurrently.
+void PhysicsSystem::find_first_impact(uint i, std::vector<Impact> &found) const {
+    if (collision_layers[i] == 0 || COLLISION_MATRIX[lowest_set_bit(collision_layers[i])] == 0)
+        return;
+    auto &motion_container = registry.motions;
+    int mask = COLLISION_MATRIX[lowest_set_bit(collision_layers[i])];
+    Entity entity = motion_container.entities[i];
+    const Motion &motion = motion_container.components[i];
+    const Mesh *mesh = collision_layers[i] == LAYER_MISSILE ? registry.meshPtrs.peek(entity) : nullptr;
+    float reach = mesh ? mesh->bounding_radius * max(abs(motion.scale.x), abs(motion.scale.y)) : motion.radius;
+    vec2 travel = motion.position - motion.previous_position;
+
+    Impact first = {2.f, entity, entity};
+    collision_grid.query(motion.previous_position + travel / 2.f, reach + length(travel) / 2.f, [&](int j) {
+        if (!(collision_layers[j] & mask))
+            return;
+        const Motion &motion_other = motion_container.components[j];
+        vec2 offset = motion.previous_position - motion_other.previous_position;
+        vec2 relative_travel = travel - (motion_other.position - motion_other.previous_position);
+        float entry = time_of_entry(offset, relative_travel, reach + motion_other.radius);
+        if (entry < 0.f || entry >= first.time)
+            return;
+
+        if (mesh) {
+            // The bounding circles meet; confirm with the hull at closest approach, then at the step's end.
+            float a = dot(relative_travel, relative_travel);
+            float closest = a > 0.f ? min(max(-dot(offset, relative_travel) / a, entry), 1.f) : entry;
+            Motion missile_at = motion;
+            Motion other_at = motion_other;
+            missile_at.position = motion.previous_position + closest * travel;
+            other_at.position = mix(motion_other.previous_position, motion_other.position, closest);
+            if (!collides(*mesh, missile_at, other_at) && !collides(*mesh, motion, motion_other))
+                return;
+        }
+        first = {entry, entity, motion_container.entities[j]};
+    });
+    if (first.time <= 1.f)
+        found.push_back(first);
+}
+
+// Bodies are swept from their previous to their current position, so one that crosses another within a
+// step is still caught. Missiles collide by their mesh hull, everything else by its radius. Each body on
+// a row of COLLISION_MATRIX reports only its earliest contact, since it is destroyed or teleported there,
+// and contacts are reported in time order.
+void PhysicsSystem::detect_collisions() {
+    auto &motion_container = registry.motions;
+    int target_layers = 0;
+    for (int row: COLLISION_MATRIX)
+        target_layers |= row;
+
+    collision_grid.clear();
+    collision_layers.resize(motion_container.size());
+    for (uint j = 0; j < motion_container.size(); j++) {
+        const Motion &motion = motion_container.components[j];
+        collision_layers[j] = collision_layer(motion_container.entities[j], motion);
+        if (!(collision_layers[j] & target_layers))
+            continue;
+        vec2 travel = motion.position - motion.previous_position;
+        collision_grid.insert((int) j, motion.previous_position + travel / 2.f, motion.radius + length(travel) / 2.f);
     }
 
-    auto &missile_container = registry.missiles;
-    for (uint i = 0; i < missile_container.components.size(); i++) {
-        Motion &motion_missile = registry.motions.get(missile_container.entities[i]);
-        Entity entity_missile = missile_container.entities[i];
-        for (uint j = 0; j < motion_container.components.size(); j++) {
-            Motion &motion_other = motion_container.components[j];
-            Entity entity_other = motion_container.entities[j];
-            if (registry.missiles.has(entity_other) || registry.ignore_physics.has(entity_other))
-                continue;
-            if (collides(entity_missile, motion_missile, motion_other)) {
-                Mix_PlayChannel(-1, world_system.missile_destroyed_sound, 0);
-                registry.collisions.emplace_with_duplicates(entity_missile, entity_other);
-                registry.collisions.emplace_with_duplicates(entity_other, entity_missile);
-            }
+    // Each chunk collects its own impacts; see `deterministic` for how they are merged.
+    size_t chunk = chunk_size(motion_container.size());
+    chunk_impacts.resize((motion_container.size() + chunk - 1) / chunk);
+    impacts.clear();
+    workers.parallel_for(motion_container.size(), chunk, [&](size_t begin, size_t end) {
+        std::vector<Impact> &found = chunk_impacts[begin / chunk];
+        found.clear();
+        for (size_t i = begin; i < end; i++)
+            find_first_impact((uint) i, found);
+        if (!deterministic) {
+            std::lock_guard<std::mutex> lock(impacts_mutex);
+            impacts.insert(impacts.end(), found.begin(), found.end());
         }
+    });
+    if (deterministic)
+        for (const std::vector<Impact> &found: chunk_impacts)
+            impacts.insert(impacts.end(), found.begin(), found.end());
+
+    std::sort(impacts.begin(), impacts.end(), [](const Impact &a, const Impact &b) { return a.time < b.time; });
+    for (Impact &impact: impacts) {
+        if (registry.missiles.has(impact.entity))
+            Mix_PlayChannel(-1, world_system.missile_destroyed_sound, 0);
+        registry.collisions.emplace_with_duplicates(impact.entity, impact.other);
+        registry.collisions.emplace_with_duplicates(impact.other, impact.entity);
     }
-}
\ No newline at end of file
+}
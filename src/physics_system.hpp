@@ -4,10 +4,242 @@
 #include "tiny_ecs.hpp"
 #include "components.hpp"
 #include "tiny_ecs_registry.hpp"
+#include "barnes_hut.hpp"
+#include "gravity_kernel.hpp"
+#include "gravity_field.hpp"
+#include "particle_mesh.hpp"
+#include "spatial_hash.hpp"
+#include "worker_pool.hpp"
+
+const float G = 10000.f;
+// Bodies lighter than this (missiles, HUD, background) only receive gravity and are never summed as sources.
+const float MIN_ATTRACTOR_MASS = 1e-3f;
+// Plummer softening length: every solver computes gravity as if distances were sqrt(d^2 + softening^2), so
+// the pull levels off inside a close encounter instead of diverging.
+const float GRAVITY_SOFTENING = 10.f;
+
+// Semi-implicit Euler splits a body's step into sub-steps when one step would change its velocity by more
+// than this fraction of its speed plus the softening speed scale; see substep_count().
+const float SUBSTEP_TOLERANCE = 0.1f;
+const int MAX_SUBSTEPS = 64;
+// Block timesteps put each body on a step of PHYSICS_STEP_MS / 2^level, with level at most this, so that
+// MAX_SUBSTEPS of the finest level make up one step.
+const int MAX_BLOCK_LEVEL = 6;
+
+// Physics always advances in steps of this length, however long the frame took.
+const float PHYSICS_STEP_MS = 1000.f / 240.f;
+// Catch-up limit per frame; time beyond it is dropped, so a long hitch slows the game down instead of
+// snowballing into ever longer frames.
+const int MAX_PHYSICS_STEPS_PER_FRAME = 12;
+
+// Broad-phase cell edge; a few times the largest collider radius keeps most bodies in one to four cells.
+const float COLLISION_CELL_SIZE = 250.f;
+
+// Node spacing of the cached gravity field. Bodies within a few cells of a cached attractor sum it exactly.
+const float GRAVITY_FIELD_CELL_SIZE = 100.f;
+
+// Node spacing of the particle mesh, which spans twice the scene so that asteroids spawned outside it are
+// still on the grid. Attractors at least PARTICLE_MESH_EXACT_MASS, such as the sun, planets and gravity
+// missiles, stay off the mesh and are summed exactly, since the mesh blurs a pull over a couple of cells.
+const float PARTICLE_MESH_CELL_SIZE = 100.f;
+const float PARTICLE_MESH_EXACT_MASS = 100.f;
+
+// Bodies per chunk of work in deterministic mode. A multiple of 8, so SIMD chunks fill whole vectors.
+const size_t PHYSICS_CHUNK_SIZE = 256;
+
+// Bit flags. A body takes the first layer that matches its components; LAYER_BODY covers any other
+// physical body with a radius.
+enum CollisionLayer {
+    LAYER_MISSILE = 1,
+    LAYER_ASTEROID = 2 * LAYER_MISSILE,
+    LAYER_PLANET = 2 * LAYER_ASTEROID,
+    LAYER_SUN = 2 * LAYER_PLANET,
+    LAYER_WORMHOLE = 2 * LAYER_SUN,
+    LAYER_BODY = 2 * LAYER_WORMHOLE
+};
+const int COLLISION_LAYER_COUNT = 6;
+
+// Row i lists the layers a body on layer 1 << i is swept against. Each pair of layers appears in one row
+// only, so every contact is found once; a row's bodies report only their earliest contact per step.
+const int COLLISION_MATRIX[COLLISION_LAYER_COUNT] = {
+        LAYER_ASTEROID | LAYER_PLANET | LAYER_SUN | LAYER_WORMHOLE | LAYER_BODY,
+        LAYER_PLANET | LAYER_SUN,
+        0,
+        0,
+        0,
+        0
+};
+
+// FIELD samples attractors on rails from a precomputed grid and sums the others directly. PARTICLE_MESH
+// solves for the light attractors on a grid with FFTs, for scenes with very many of them.
+enum class GRAVITY_SOLVER {
+    DIRECT = 0,
+    BARNES_HUT = DIRECT + 1,
+    SIMD = BARNES_HUT + 1,
+    FIELD = SIMD + 1,
+    PARTICLE_MESH = FIELD + 1,
+    SOLVER_COUNT = PARTICLE_MESH + 1
+};
+
+// Semi-implicit Euler updates bodies in place, one after another. The others advance every body together,
+// with attractors on rails placed where their orbit is at each stage's time. BLOCK_TIMESTEPS is
+// kick-drift-kick with a power-of-two step per body, so only bodies in close encounters pay for small steps.
+enum class INTEGRATOR {
+    SEMI_IMPLICIT_EULER = 0,
+    LEAPFROG = SEMI_IMPLICIT_EULER + 1,
+    VELOCITY_VERLET = LEAPFROG + 1,
+    RK4 = VELOCITY_VERLET + 1,
+    BLOCK_TIMESTEPS = RK4 + 1,
+    INTEGRATOR_COUNT = BLOCK_TIMESTEPS + 1
+};
 
 class PhysicsSystem {
 public:
+    // Banks the frame's wall-clock time and returns how many fixed steps to run now.
+    int begin_frame(float elapsed_ms);
+
     void step(float timeSpentFromLastUpdate);
+
+    // Simulated seconds so far; AngularMotion orbits are functions of it.
+    double simulation_time = 0.0;
+
+    // Where to draw a body: between its previous and current physics state, by the unsimulated
+    // fraction of a step. Motions written outside physics since the last step are drawn as they are.
+    vec2 render_position(Entity entity, const Motion &motion) const;
+
+    float render_angle(Entity entity, const Motion &motion) const;
+
+    void cycle_gravity_solver();
+
+    void cycle_integrator();
+
+    // Threads stepping physics, including the calling one.
+    void set_thread_count(unsigned int count);
+
+    void cycle_thread_count();
+
+    GRAVITY_SOLVER gravity_solver = GRAVITY_SOLVER::DIRECT;
+
+    INTEGRATOR integrator = INTEGRATOR::SEMI_IMPLICIT_EULER;
+
+    // Opening angle for Barnes-Hut; smaller is more accurate, 0 degenerates to direct summation.
+    float barnes_hut_theta = 0.5f;
+
+    // Work is cut into fixed-size chunks and collisions are merged in chunk order, so every thread count
+    // steps bit-identically to one thread. Otherwise chunks are sized to the thread count and collisions
+    // are merged as chunks finish, which can swap the order of contacts made at the same instant.
+    bool deterministic = true;
+
+private:
+    bool interpolates(Entity entity) const;
+
+    WorkerPool workers;
+
+    size_t chunk_size(size_t count) const;
+
+    void parallel_for(size_t count, const std::function<void(size_t, size_t)> &f);
+
+    float accumulator_ms = 0.f;
+    uint32_t interpolation_tick = 0;
+
+    void update_attractors();
+
+    void build_gravity_sources();
+
+    void build_gravity_bodies();
+
+    void update_gravity_field();
+
+    void update_particle_mesh();
+
+    void build_particle_mesh();
+
+    vec2 get_gravity_effect(uint i);
+
+    vec2 get_gravity(uint i);
+
+    void join_motions();
+
+    void advance_rails();
+
+    void advance_body(uint i, float step_seconds);
+
+    void gather_bodies();
+
+    void evaluate_gravity(const std::vector<vec2> &positions, double seconds, std::vector<vec2> &accelerations,
+                          const std::vector<uint> *active = nullptr);
+
+    void integrate(double start_seconds, float step_seconds);
+
+    void integrate_blocks(double start_seconds, float step_seconds);
+
+    // Per entry of registry.motions for this step: its SpeedUp boost or 1, and whether it is on rails.
+    std::vector<float> motion_boosts;
+    std::vector<bool> motion_on_rails;
+
+    uint32_t attractor_seen_tick = 0;
+    // Indices into registry.motions of this step's attractors.
+    std::vector<uint> attractor_slots;
+    // Start-of-step attractor positions, for bodies that read them while attractors move in place.
+    std::vector<vec2> attractor_positions;
+
+    BarnesHutTree gravity_tree;
+    std::vector<vec2> source_positions;
+    std::vector<float> source_masses;
+    // SIMD backend: every motion as a receiver, the attractors as sources, accelerations per motion.
+    GravityBodies gravity_receivers;
+    GravityBodies gravity_sources;
+    std::vector<float> gravity_ax;
+    std::vector<float> gravity_ay;
+    // Index into the attractor and source arrays for each entry of registry.motions, or -1.
+    std::vector<int> source_index;
+    // Field backend: attractors on rails are cached, the others (by attractor index) are summed directly.
+    GravityField gravity_field{{0.f, 0.f}, {scene_width_px, scene_height_px}, GRAVITY_FIELD_CELL_SIZE};
+    std::vector<AngularMotion> field_orbits;
+    std::vector<float> field_masses;
+    std::vector<int> dynamic_sources;
+    // Particle-mesh backend: the attractors (by attractor index) heavy enough to be summed exactly.
+    ParticleMesh particle_mesh{{0.f, 0.f}, {2 * scene_width_px, 2 * scene_height_px}, PARTICLE_MESH_CELL_SIZE};
+    std::vector<int> exact_sources;
+    std::vector<vec2> mesh_positions;
+    std::vector<float> mesh_masses;
+
+    // Bodies advanced by the whole-system integrators: every motion without AngularMotion.
+    std::vector<uint> body_slots;
+    std::vector<float> body_boosts;
+    std::vector<bool> body_feels_gravity;
+    // Attractor index of each body, or -1; and body index of each attractor, or -1 when it is on rails.
+    std::vector<int> body_source;
+    std::vector<int> source_body;
+    // Orbit of each attractor on rails; unused for the others.
+    std::vector<AngularMotion> source_orbits;
+    std::vector<vec2> start_positions;
+    std::vector<vec2> start_velocities;
+    std::vector<vec2> stage_positions;
+    std::vector<vec2> stage_velocities;
+    std::vector<vec2> position_sum;
+    std::vector<vec2> velocity_sum;
+    std::vector<vec2> accelerations;
+    // Block timesteps: each body's level, and the bodies whose step ends at the current tick.
+    std::vector<int> body_levels;
+    std::vector<uint> active_bodies;
+
+    // Collision targets by index into registry.motions, and each motion's layer for this step.
+    SpatialHash collision_grid{{0.f, 0.f}, {scene_width_px, scene_height_px}, COLLISION_CELL_SIZE};
+
+    struct Impact {
+        float time;
+        Entity entity;
+        Entity other;
+    };
+    std::vector<Impact> impacts;
+    std::vector<std::vector<Impact>> chunk_impacts;
+    std::mutex impacts_mutex;
+    std::vector<int> collision_layers;
+
+    void find_first_impact(uint i, std::vector<Impact> &found) const;
+
+    void detect_collisions();
 };
 
 extern PhysicsSystem physics_system;
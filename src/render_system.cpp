@@ -3,15 +3,16 @@
 
 #include "tiny_ecs_registry.hpp"
 #include "camera_system.hpp"
+#include "physics_system.hpp"
 
 RenderSystem render_system;
 
 void RenderSystem::drawTexturedMesh(Entity entity, const mat3 &projection, float elapsed_ms) {
     if (registry.hidden.has(entity)) return;
-    Motion &motion = registry.motions.get(entity);
+    const Motion &motion = registry.motions.peek(entity);
     Transform transform;
-    transform.translate(motion.position);
-    transform.rotate(motion.angle);
+    transform.translate(physics_system.render_position(entity, motion));
+    transform.rotate(physics_system.render_angle(entity, motion));
     transform.scale(motion.scale);
 
     assert(registry.renderRequests.has(entity));
@@ -106,6 +106,9 @@ private:
 
     Entity screen_state_entity;
 
+    WorldPhase hud_phase = WorldPhase::WELCOME;
+    uint32_t hud_seen_tick = 0;
+
     ImFont *header;
 
     float imgui_scale;
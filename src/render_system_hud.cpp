@@ -126,13 +126,21 @@ void RenderSystem::drawGameHud() {
 
 void RenderSystem::updateVisibilityHudEntities() {
     WorldPhase world_phase = registry.phases.components[0].phase;
-    for (int i = 0; i < registry.huds.components.size(); i++) {
+    bool phase_changed = world_phase != hud_phase;
+    if (!phase_changed && !registry.huds.changed_since(hud_seen_tick))
+        return;
+
+    for (int i = 0; i < (int) registry.huds.components.size(); i++) {
+        if (!phase_changed && registry.huds.versions[i] <= hud_seen_tick)
+            continue;
         Entity e = registry.huds.entities[i];
         HUDComponent huds = registry.huds.components[i];
         bool in_phase = (huds.phases & world_phase) != world_phase;
         if (in_phase && !registry.hidden.has(e)) registry.hidden.emplace(e);
         if (!in_phase && registry.hidden.has(e)) registry.hidden.remove(e);
     }
+    hud_phase = world_phase;
+    hud_seen_tick = registry.advance_tick();
 }
 
 void RenderSystem::drawGameOver() {
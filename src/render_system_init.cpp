@@ -277,6 +277,9 @@ void RenderSystem::initializeGlGeometryBuffers() {
 
     const std::vector<uint16_t> screen_indices = {0, 1, 2};
     bindVBOandIBO(GEOMETRY_BUFFER_ID::SCREEN_TRIANGLE, screen_vertices, screen_indices);
+
+    for (Mesh &mesh: meshes)
+        mesh.compute_bounds();
 }
 
 RenderSystem::~RenderSystem() {
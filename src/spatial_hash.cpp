@@ -0,0 +1,46 @@
+#include "spatial_hash.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+SpatialHash::SpatialHash(vec2 centre, vec2 size, float cell_size) :
+        origin(centre - size / 2.f),
+        cell_size(cell_size),
+        columns(std::max(1, (int) std::ceil(size.x / cell_size))),
+        rows(std::max(1, (int) std::ceil(size.y / cell_size))),
+        cells((size_t) (columns * rows)) {
+}
+
+int SpatialHash::column_of(float x) const {
+    float column = std::floor((x - origin.x) / cell_size);
+    // Written so that NaN lands in the first column too.
+    if (!(column > 0.f))
+        return 0;
+    return column >= columns - 1 ? columns - 1 : (int) column;
+}
+
+int SpatialHash::row_of(float y) const {
+    float row = std::floor((y - origin.y) / cell_size);
+    if (!(row > 0.f))
+        return 0;
+    return row >= rows - 1 ? rows - 1 : (int) row;
+}
+
+void SpatialHash::clear() {
+    for (std::vector<int> &cell: cells)
+        cell.clear();
+}
+
+void SpatialHash::insert(int id, vec2 centre, float radius) {
+    int c0 = column_of(centre.x - radius), c1 = column_of(centre.x + radius);
+    int r0 = row_of(centre.y - radius), r1 = row_of(centre.y + radius);
+    if (id >= (int) first_column.size()) {
+        first_column.resize(id + 1);
+        first_row.resize(id + 1);
+    }
+    first_column[id] = c0;
+    first_row[id] = r0;
+    for (int r = r0; r <= r1; r++)
+        for (int c = c0; c <= c1; c++)
+            cells[r * columns + c].push_back(id);
+}
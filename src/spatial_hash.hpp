@@ -0,0 +1,43 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "common.hpp"
+
+// Uniform grid broad-phase. Circles are bucketed into every cell their bounding box touches; a query
+// reports each stored id whose cells overlap the query circle's box, once. Ids are caller-chosen,
+// small and dense (e.g. indices into a container). Anything outside the grid is clamped to its border.
+class SpatialHash {
+    vec2 origin;
+    float cell_size;
+    int columns;
+    int rows;
+    std::vector<std::vector<int>> cells;
+    // First (lowest) column and row of each id's cell box. A query reports an id only from the first
+    // cell where both boxes overlap, which keeps queries read-only and safe to run concurrently.
+    std::vector<int> first_column;
+    std::vector<int> first_row;
+
+    int column_of(float x) const;
+
+    int row_of(float y) const;
+
+public:
+    SpatialHash(vec2 centre, vec2 size, float cell_size);
+
+    void clear();
+
+    void insert(int id, vec2 centre, float radius);
+
+    template<typename F>
+    void query(vec2 centre, float radius, F f) const {
+        int c0 = column_of(centre.x - radius), c1 = column_of(centre.x + radius);
+        int r0 = row_of(centre.y - radius), r1 = row_of(centre.y + radius);
+        for (int r = r0; r <= r1; r++)
+            for (int c = c0; c <= c1; c++)
+                for (int id: cells[r * columns + c])
+                    if (c == std::max(c0, first_column[id]) && r == std::max(r0, first_row[id]))
+                        f(id);
+    }
+};
@@ -1,5 +1,31 @@
 #include "tiny_ecs.hpp"
 
-unsigned int Entity::id_count = 1;
+unsigned int Entity::create() {
+    EntityPool &pool = entity_pool();
+    unsigned int index;
+    bool out_of_slots = pool.generations.size() > INDEX_MASK;
+    if (pool.free_count() >= MIN_FREE_INDICES || (out_of_slots && pool.free_count() > 0)) {
+        index = pool.free_indices[pool.free_head++];
+        // Drop the consumed front once it is most of the buffer, so the queue stays amortised O(1).
+        if (pool.free_head * 2 >= pool.free_indices.size()) {
+            pool.free_indices.erase(pool.free_indices.begin(), pool.free_indices.begin() + pool.free_head);
+            pool.free_head = 0;
+        }
+    } else {
+        index = (unsigned int) pool.generations.size();
+        assert(index <= INDEX_MASK && "Out of entity slots");
+        pool.generations.push_back(0);
+    }
+    return (pool.generations[index] << INDEX_BITS) | index;
+}
+
+void Entity::destroy(Entity e) {
+    if (!alive(e))
+        return;
+    EntityPool &pool = entity_pool();
+    unsigned int &generation = pool.generations[e.index()];
+    generation = (generation + 1) & (~0u >> INDEX_BITS);
+    pool.free_indices.push_back(e.index());
+}
 
 std::string type;
\ No newline at end of file
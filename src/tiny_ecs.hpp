@@ -6,39 +6,444 @@
 #include <set>
 #include <functional>
 #include <typeindex>
+#include <typeinfo>
 #include <assert.h>
 #include <iostream>
+#include <cstdio>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Handles pack a recyclable slot index in the low bits and the slot's generation in the high bits,
+// so a handle kept after its entity was destroyed no longer matches once the slot is reused.
 class Entity {
     unsigned int id;
-    static unsigned int id_count;
+
+    static unsigned int create();
 
 public:
+    static const unsigned int INDEX_BITS = 20;
+    static const unsigned int INDEX_MASK = (1u << INDEX_BITS) - 1;
+
     Entity() {
-        id = id_count++;
+        id = create();
     }
 
     operator unsigned int() { return id; }
+
+    unsigned int index() const { return id & INDEX_MASK; }
+
+    unsigned int generation() const { return id >> INDEX_BITS; }
+
+    static bool alive(Entity e);
+
+    static void destroy(Entity e);
+
+    // The live handle currently occupying a slot; used by storages that only keep slot indices.
+    static Entity at_index(unsigned int index);
+
+    // Rebuilds a handle from its raw id without minting a new one, e.g. when loading a snapshot.
+    static Entity from_id(unsigned int id) {
+        return Entity(FromId(), id);
+    }
+
+private:
+    struct FromId {
+    };
+
+    Entity(FromId, unsigned int id) : id(id) {
+    }
+};
+
+// Destroyed slots are reused first in, first out, and only once this many are waiting. Otherwise a slot
+// freed and refilled every frame would take every reuse and wrap its generation within minutes, after
+// which stale handles to it would read as alive again.
+const size_t MIN_FREE_INDICES = 1024;
+
+struct EntityPool {
+    // Slot 0 is never handed out, so a zero id never names a live entity.
+    std::vector<unsigned int> generations = {0};
+    // Queue of destroyed slots, oldest first from free_head on.
+    std::vector<unsigned int> free_indices;
+    size_t free_head = 0;
+
+    size_t free_count() const {
+        return free_indices.size() - free_head;
+    }
+};
+
+// Function-local so that systems holding Entity members can mint ids during static initialisation.
+inline EntityPool &entity_pool() {
+    static EntityPool pool;
+    return pool;
+}
+
+inline bool Entity::alive(Entity e) {
+    const std::vector<unsigned int> &generations = entity_pool().generations;
+    return e.index() < generations.size() && generations[e.index()] == e.generation();
+}
+
+inline Entity Entity::at_index(unsigned int index) {
+    return Entity(FromId(), (entity_pool().generations[index] << INDEX_BITS) | index);
+}
+
+// Flat byte buffer holding registry state. Components are copied bytewise, so a snapshot is only
+// meaningful inside the process that took it (e.g. Mesh pointers).
+typedef std::vector<char> Snapshot;
+
+class SnapshotWriter {
+    Snapshot &out;
+
+public:
+    explicit SnapshotWriter(Snapshot &out) : out(out) {
+    }
+
+    void write_bytes(const void *data, size_t size) {
+        const char *bytes = static_cast<const char *>(data);
+        out.insert(out.end(), bytes, bytes + size);
+    }
+
+    template<typename T>
+    void write(const T &value) {
+        static_assert(std::is_trivially_copyable<T>::value, "Snapshot values must be trivially copyable");
+        write_bytes(&value, sizeof(T));
+    }
+
+    template<typename T>
+    void write_vector(const std::vector<T> &values) {
+        static_assert(std::is_trivially_copyable<T>::value, "Snapshot values must be trivially copyable");
+        write((uint64_t) values.size());
+        write_bytes(values.data(), values.size() * sizeof(T));
+    }
+};
+
+class SnapshotReader {
+    const Snapshot &in;
+    size_t offset = 0;
+
+public:
+    explicit SnapshotReader(const Snapshot &in) : in(in) {
+    }
+
+    // Whether every byte has been read.
+    bool complete() const {
+        return offset == in.size();
+    }
+
+    void read_bytes(void *data, size_t size) {
+        assert(offset + size <= in.size() && "Snapshot is truncated");
+        if (size == 0)
+            return;
+        memcpy(data, in.data() + offset, size);
+        offset += size;
+    }
+
+    // Copies into raw storage so that types without a default constructor can be read.
+    template<typename T>
+    T read() {
+        static_assert(std::is_trivially_copyable<T>::value, "Snapshot values must be trivially copyable");
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+        read_bytes(&storage, sizeof(T));
+        return *reinterpret_cast<T *>(&storage);
+    }
+
+    template<typename T>
+    void read_vector(std::vector<T> &values) {
+        values.resize((size_t) read<uint64_t>());
+        read_bytes(values.data(), values.size() * sizeof(T));
+    }
 };
 
-struct ContainerInterface {
-    virtual void clear() = 0;
+inline void save_entity_pool(SnapshotWriter &writer) {
+    const EntityPool &pool = entity_pool();
+    writer.write_vector(pool.generations);
+    writer.write_vector(std::vector<unsigned int>(pool.free_indices.begin() + pool.free_head, pool.free_indices.end()));
+}
+
+// Slots that are free in the snapshot get a generation newer than any handle minted since it was
+// taken, so those handles keep reading as stale after the restore.
+inline void load_entity_pool(SnapshotReader &reader) {
+    EntityPool &pool = entity_pool();
+    std::vector<unsigned int> current = pool.generations;
+    reader.read_vector(pool.generations);
+    reader.read_vector(pool.free_indices);
+    pool.free_head = 0;
+
+    const unsigned int generation_mask = ~0u >> Entity::INDEX_BITS;
+    for (unsigned int index: pool.free_indices)
+        if (index < current.size())
+            pool.generations[index] = (std::max(pool.generations[index], current[index]) + 1) & generation_mask;
+    for (size_t index = pool.generations.size(); index < current.size(); index++) {
+        pool.generations.push_back((current[index] + 1) & generation_mask);
+        pool.free_indices.push_back((unsigned int) index);
+    }
+}
+
+typedef uint64_t ComponentMask;
 
-    virtual size_t size() = 0;
+inline unsigned int lowest_set_bit(ComponentMask mask) {
+#ifdef _MSC_VER
+    unsigned long bit;
+    _BitScanForward64(&bit, mask);
+    return (unsigned int) bit;
+#else
+    return (unsigned int) __builtin_ctzll(mask);
+#endif
+}
 
-    virtual void remove(Entity e) = 0;
+// One bit per registered container for every entity slot, so the registry knows which containers
+// an entity lives in without asking each of them.
+class SignatureTable {
+    std::vector<ComponentMask> masks;
 
-    virtual bool has(Entity entity) = 0;
+public:
+    ComponentMask get(unsigned int index) const {
+        return index < masks.size() ? masks[index] : 0;
+    }
+
+    void add(unsigned int index, ComponentMask bit) {
+        if (index >= masks.size())
+            masks.resize(index + 1, 0);
+        masks[index] |= bit;
+    }
+
+    void remove(unsigned int index, ComponentMask bit) {
+        masks[index] &= ~bit;
+    }
+
+    void save(SnapshotWriter &writer) const {
+        writer.write_vector(masks);
+    }
+
+    void load(SnapshotReader &reader) {
+        reader.read_vector(masks);
+    }
+
+    void clear() {
+        masks.clear();
+    }
+};
+
+// Links a container to the registry's signature table and change clock; set up once by the owning Registry.
+struct RegistryLink {
+    SignatureTable *signatures = nullptr;
+    ComponentMask component_bit = 0;
+    const uint32_t *change_tick = nullptr;
+
+    // Tick of the last insert or remove, so consumers can tell when membership changed.
+    uint32_t structure_version = 0;
+
+    void attach(SignatureTable *table, unsigned int bit, const uint32_t *tick) {
+        signatures = table;
+        component_bit = ComponentMask(1) << bit;
+        change_tick = tick;
+    }
+
+    uint32_t now() const {
+        return change_tick ? *change_tick : 0;
+    }
+};
+
+class SparseIndex {
+    static const unsigned int PAGE_BITS = 12;
+    static const unsigned int PAGE_SIZE = 1u << PAGE_BITS;
+    static const unsigned int PAGE_MASK = PAGE_SIZE - 1;
+
+    // Slots hold dense index + 1 so that a freshly zeroed page reads as "absent".
+    std::vector<std::unique_ptr<unsigned int[]>> pages;
+
+public:
+    bool contains(unsigned int key) const {
+        unsigned int page = key >> PAGE_BITS;
+        return page < pages.size() && pages[page] && pages[page][key & PAGE_MASK] != 0;
+    }
+
+    unsigned int at(unsigned int key) const {
+        return pages[key >> PAGE_BITS][key & PAGE_MASK] - 1;
+    }
+
+    void set(unsigned int key, unsigned int dense) {
+        unsigned int page = key >> PAGE_BITS;
+        if (page >= pages.size())
+            pages.resize(page + 1);
+        if (!pages[page])
+            pages[page].reset(new unsigned int[PAGE_SIZE]());
+        pages[page][key & PAGE_MASK] = dense + 1;
+    }
+
+    void erase(unsigned int key) {
+        pages[key >> PAGE_BITS][key & PAGE_MASK] = 0;
+    }
+
+    void clear() {
+        pages.clear();
+    }
+};
+
+// Dense list of pointers into fixed-size chunks. Elements are never moved once constructed, so their
+// addresses stay valid across later inserts and removals until the element itself is removed.
+template<typename T>
+class ChunkedPool {
+    static const size_t CHUNK_SIZE = 256;
+    typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Slot;
+
+    std::vector<std::unique_ptr<Slot[]>> chunks;
+    std::vector<T *> items;
+    std::vector<T *> free_slots;
+    size_t used_in_last_chunk = CHUNK_SIZE;
+
+    T *allocate() {
+        if (!free_slots.empty()) {
+            T *slot = free_slots.back();
+            free_slots.pop_back();
+            return slot;
+        }
+        if (used_in_last_chunk == CHUNK_SIZE) {
+            chunks.emplace_back(new Slot[CHUNK_SIZE]);
+            used_in_last_chunk = 0;
+        }
+        return reinterpret_cast<T *>(&chunks.back()[used_in_last_chunk++]);
+    }
+
+    void release(T *item) {
+        item->~T();
+        free_slots.push_back(item);
+    }
+
+public:
+    class iterator {
+        typename std::vector<T *>::iterator it;
+
+    public:
+        explicit iterator(typename std::vector<T *>::iterator it) : it(it) {
+        }
+
+        T &operator*() const { return **it; }
+
+        T *operator->() const { return *it; }
+
+        iterator &operator++() {
+            ++it;
+            return *this;
+        }
+
+        bool operator==(const iterator &other) const { return it == other.it; }
+
+        bool operator!=(const iterator &other) const { return it != other.it; }
+    };
+
+    ChunkedPool() {
+    }
+
+    ChunkedPool(const ChunkedPool &) = delete;
+
+    ChunkedPool &operator=(const ChunkedPool &) = delete;
+
+    ~ChunkedPool() {
+        clear();
+    }
+
+    size_t size() const { return items.size(); }
+
+    bool empty() const { return items.empty(); }
+
+    T &operator[](size_t i) { return *items[i]; }
+
+    T &back() { return *items.back(); }
+
+    iterator begin() { return iterator(items.begin()); }
+
+    iterator end() { return iterator(items.end()); }
+
+    void reserve(size_t n) { items.reserve(n); }
+
+    void push_back(T &&value) {
+        T *slot = allocate();
+        new(slot) T(std::move(value));
+        items.push_back(slot);
+    }
+
+    void pop_back() {
+        release(items.back());
+        items.pop_back();
+    }
+
+    // Unlike the std::vector path, the last element's pointer moves into the hole, not its value.
+    void swap_remove(size_t i) {
+        release(items[i]);
+        items[i] = items.back();
+        items.pop_back();
+    }
+
+    void permute(const std::vector<unsigned int> &order) {
+        std::vector<T *> items_new;
+        items_new.reserve(order.size());
+        for (unsigned int i: order)
+            items_new.push_back(items[i]);
+        items = std::move(items_new);
+    }
+
+    void clear() {
+        for (T *item: items)
+            item->~T();
+        items.clear();
+        free_slots.clear();
+        chunks.clear();
+        used_in_last_chunk = CHUNK_SIZE;
+    }
+};
+
+template<typename T>
+void swap_remove(std::vector<T> &v, size_t i) {
+    v[i] = std::move(v.back());
+    v.pop_back();
+}
+
+template<typename T>
+void swap_remove(ChunkedPool<T> &pool, size_t i) {
+    pool.swap_remove(i);
+}
+
+template<typename T>
+void permute(std::vector<T> &v, const std::vector<unsigned int> &order) {
+    std::vector<T> v_new;
+    v_new.reserve(v.size());
+    for (unsigned int i: order)
+        v_new.push_back(std::move(v[i]));
+    v = std::move(v_new);
+}
+
+template<typename T>
+void permute(ChunkedPool<T> &pool, const std::vector<unsigned int> &order) {
+    pool.permute(order);
+}
+
+// Specialise to std::true_type for components that systems hold on to by address across frames.
+template<typename Component>
+struct stable_storage : std::false_type {
 };
 
 template<typename Component>
-class ComponentContainer : public ContainerInterface {
+class ComponentContainer : public RegistryLink {
 private:
-    std::unordered_map<unsigned int, unsigned int> map_entity_componentID;
-    bool registered = false;
+    SparseIndex map_entity_componentID;
 public:
-    std::vector<Component> components;
+    typename std::conditional<stable_storage<Component>::value,
+            ChunkedPool<Component>, std::vector<Component>>::type components;
     std::vector<Entity> entities;
+    // Registry tick of the last mutable access to each component, parallel to components.
+    std::vector<uint32_t> versions;
+
+    // Structural changes recorded while a system is iterating; applied by flush().
+    std::vector<std::pair<Entity, Component>> pending_inserts;
+    std::vector<Entity> pending_removals;
 
     ComponentContainer() {
     }
@@ -46,9 +451,13 @@ public:
     inline Component &insert(Entity e, Component c, bool check_for_duplicates = true) {
         assert(!(check_for_duplicates && has(e)) && "Entity already contained in ECS registry");
 
-        map_entity_componentID[e] = (unsigned int) components.size();
+        map_entity_componentID.set(e.index(), (unsigned int) components.size());
+        if (signatures)
+            signatures->add(e.index(), component_bit);
         components.push_back(std::move(c));
         entities.push_back(e);
+        versions.push_back(now());
+        structure_version = now();
         return components.back();
     };
 
@@ -62,48 +471,522 @@ public:
         return insert(e, Component(std::forward<Args>(args)...), false);
     };
 
+    // Mutable access stamps the component as changed at the current tick; use peek() to only read.
     Component &get(Entity e) {
         assert(has(e) && "Entity not contained in ECS registry");
-        return components[map_entity_componentID[e]];
+        unsigned int cID = map_entity_componentID.at(e.index());
+        versions[cID] = now();
+        return components[cID];
+    }
+
+    const Component &peek(Entity e) {
+        assert(has(e) && "Entity not contained in ECS registry");
+        return components[map_entity_componentID.at(e.index())];
+    }
+
+    // Position of e's component in components[], for systems that write through it directly or keep
+    // arrays parallel to it.
+    size_t index_of(Entity e) {
+        assert(has(e) && "Entity not contained in ECS registry");
+        return map_entity_componentID.at(e.index());
+    }
+
+    // For systems that write through components[] directly.
+    void touch(Entity e) {
+        if (has(e))
+            versions[map_entity_componentID.at(e.index())] = now();
+    }
+
+    bool changed_since(Entity e, uint32_t tick) {
+        return has(e) && versions[map_entity_componentID.at(e.index())] > tick;
+    }
+
+    bool changed_since(uint32_t tick) {
+        return structure_version > tick ||
+               std::any_of(versions.begin(), versions.end(), [&](uint32_t v) { return v > tick; });
+    }
+
+    template<typename F>
+    void each_changed_since(uint32_t tick, F f) {
+        for (size_t i = 0; i < entities.size(); i++)
+            if (versions[i] > tick)
+                f(entities[i], components[i]);
     }
 
     bool has(Entity entity) {
-        return map_entity_componentID.count(entity) > 0;
+        unsigned int index = entity.index();
+        return map_entity_componentID.contains(index) && entities[map_entity_componentID.at(index)] == entity;
     }
 
     void remove(Entity e) {
         if (has(e)) {
-            int cID = map_entity_componentID[e];
-            components[cID] = std::move(components.back());
+            unsigned int cID = map_entity_componentID.at(e.index());
+            swap_remove(components, cID);
             entities[cID] = entities.back();
-            map_entity_componentID[entities.back()] = cID;
-            map_entity_componentID.erase(e);
-            components.pop_back();
+            versions[cID] = versions.back();
+            map_entity_componentID.set(entities.back().index(), cID);
+            map_entity_componentID.erase(e.index());
+            if (signatures)
+                signatures->remove(e.index(), component_bit);
             entities.pop_back();
+            versions.pop_back();
+            structure_version = now();
         }
     };
 
+    void defer_insert(Entity e, Component c) {
+        pending_inserts.emplace_back(e, std::move(c));
+    }
+
+    template<typename... Args>
+    void defer_emplace(Entity e, Args &&... args) {
+        defer_insert(e, Component(std::forward<Args>(args)...));
+    }
+
+    void defer_remove(Entity e) {
+        pending_removals.push_back(e);
+    }
+
+    void flush() {
+        for (Entity e: pending_removals)
+            remove(e);
+        for (auto &pending: pending_inserts)
+            insert(pending.first, std::move(pending.second));
+        pending_removals.clear();
+        pending_inserts.clear();
+    }
+
     void clear() {
+        if (signatures)
+            for (Entity e: entities)
+                signatures->remove(e.index(), component_bit);
         map_entity_componentID.clear();
         components.clear();
         entities.clear();
+        versions.clear();
+        structure_version = now();
+        pending_inserts.clear();
+        pending_removals.clear();
     }
 
     size_t size() {
         return components.size();
     }
 
+    template<typename F>
+    void each_entity(F f) {
+        for (size_t i = 0; i < entities.size(); i++)
+            f(entities[i]);
+    }
+
+    // Pending deferred changes are not part of a snapshot; take snapshots between system passes.
+    void save(SnapshotWriter &writer) {
+        writer.write((uint64_t) components.size());
+        for (size_t i = 0; i < components.size(); i++) {
+            writer.write((unsigned int) entities[i]);
+            writer.write(components[i]);
+        }
+    }
+
+    // Signature bits are restored by the registry, so this bypasses insert(). Everything loaded
+    // counts as changed at the current tick.
+    void load(SnapshotReader &reader) {
+        map_entity_componentID.clear();
+        components.clear();
+        entities.clear();
+        pending_inserts.clear();
+        pending_removals.clear();
+        size_t count = (size_t) reader.read<uint64_t>();
+        components.reserve(count);
+        entities.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            Entity e = Entity::from_id(reader.read<unsigned int>());
+            map_entity_componentID.set(e.index(), (unsigned int) i);
+            entities.push_back(e);
+            components.push_back(reader.read<Component>());
+        }
+        versions.assign(count, now());
+        structure_version = now();
+    }
+
     template<class Compare>
     void sort(Compare comparisonFunction) {
         std::sort(entities.begin(), entities.end(), comparisonFunction);
-        std::vector<Component> components_new;
-        components_new.reserve(components.size());
-        std::transform(entities.begin(), entities.end(), std::back_inserter(components_new), [&](Entity e) {
-            return std::move(get(e));
-        });
-        components = std::move(
-                components_new);
+        std::vector<unsigned int> order;
+        std::vector<uint32_t> versions_new;
+        order.reserve(entities.size());
+        versions_new.reserve(versions.size());
+        for (Entity e: entities) {
+            unsigned int cID = map_entity_componentID.at(e.index());
+            order.push_back(cID);
+            versions_new.push_back(versions[cID]);
+        }
+        permute(components, order);
+        versions = std::move(versions_new);
         for (unsigned int i = 0; i < entities.size(); i++)
-            map_entity_componentID[entities[i]] = i;
+            map_entity_componentID.set(entities[i].index(), i);
+    }
+};
+
+// Storage for empty marker components: one bit per entity slot and no per-entity allocation, so has()
+// is a bit test plus the liveness check every handle lookup shares. Bits are cleared when the entity is
+// destroyed, and a stale handle fails the generation check, so a recycled slot never reports its former
+// occupant's tags.
+template<typename Tag>
+class TagContainer : public RegistryLink {
+    std::vector<uint64_t> bits;
+    size_t count = 0;
+    Tag value;
+
+    bool bit_set(unsigned int index) const {
+        return (index >> 6) < bits.size() && (bits[index >> 6] >> (index & 63)) & 1;
+    }
+
+public:
+    std::vector<Entity> pending_inserts;
+    std::vector<Entity> pending_removals;
+    // Entities tagged or untagged since the one consumer last cleared this. Only recorded once
+    // track_changes is set, so tags nobody watches pay nothing for it.
+    std::vector<Entity> changed;
+    bool track_changes = false;
+
+    Tag &insert(Entity e, Tag = Tag(), bool check_for_duplicates = true) {
+        assert(!(check_for_duplicates && has(e)) && "Entity already contained in ECS registry");
+        unsigned int index = e.index();
+        if ((index >> 6) >= bits.size())
+            bits.resize((index >> 6) + 1, 0);
+        uint64_t bit = uint64_t(1) << (index & 63);
+        if (!(bits[index >> 6] & bit)) {
+            bits[index >> 6] |= bit;
+            if (track_changes)
+                changed.push_back(e);
+            count++;
+            structure_version = now();
+            if (signatures)
+                signatures->add(index, component_bit);
+        }
+        return value;
+    }
+
+    Tag &emplace(Entity e) {
+        return insert(e);
+    }
+
+    Tag &get(Entity e) {
+        assert(has(e) && "Entity not contained in ECS registry");
+        return value;
+    }
+
+    const Tag &peek(Entity e) {
+        assert(has(e) && "Entity not contained in ECS registry");
+        return value;
+    }
+
+    bool has(Entity e) {
+        return bit_set(e.index()) && Entity::alive(e);
+    }
+
+    void remove(Entity e) {
+        if (has(e)) {
+            bits[e.index() >> 6] &= ~(uint64_t(1) << (e.index() & 63));
+            if (track_changes)
+                changed.push_back(e);
+            count--;
+            structure_version = now();
+            if (signatures)
+                signatures->remove(e.index(), component_bit);
+        }
+    }
+
+    void defer_insert(Entity e, Tag = Tag()) {
+        pending_inserts.push_back(e);
+    }
+
+    void defer_emplace(Entity e) {
+        defer_insert(e);
+    }
+
+    void defer_remove(Entity e) {
+        pending_removals.push_back(e);
+    }
+
+    void flush() {
+        for (Entity e: pending_removals)
+            remove(e);
+        for (Entity e: pending_inserts)
+            insert(e);
+        pending_removals.clear();
+        pending_inserts.clear();
+    }
+
+    void clear() {
+        each_entity([&](Entity e) {
+            if (track_changes)
+                changed.push_back(e);
+            if (signatures)
+                signatures->remove(e.index(), component_bit);
+        });
+        bits.clear();
+        count = 0;
+        structure_version = now();
+        pending_inserts.clear();
+        pending_removals.clear();
+    }
+
+    size_t size() {
+        return count;
+    }
+
+    bool changed_since(uint32_t tick) {
+        return structure_version > tick;
+    }
+
+    void save(SnapshotWriter &writer) {
+        writer.write_vector(bits);
+        writer.write((uint64_t) count);
+    }
+
+    void load(SnapshotReader &reader) {
+        reader.read_vector(bits);
+        count = (size_t) reader.read<uint64_t>();
+        structure_version = now();
+        changed.clear();
+        pending_inserts.clear();
+        pending_removals.clear();
+    }
+
+    // Visits tagged entities in slot order by scanning the set bits of each word.
+    template<typename F>
+    void each_entity(F f) {
+        for (size_t word = 0; word < bits.size(); word++)
+            for (uint64_t w = bits[word]; w != 0; w &= w - 1)
+                f(Entity::at_index((unsigned int) (word * 64 + lowest_set_bit(w))));
+    }
+
+    Entity front() {
+        for (size_t word = 0; word < bits.size(); word++)
+            if (bits[word] != 0)
+                return Entity::at_index((unsigned int) (word * 64 + lowest_set_bit(bits[word])));
+        assert(false && "No entity contained in ECS registry");
+        return Entity::at_index(0);
+    }
+};
+
+// Empty structs are pure markers and get bitset storage; everything else is a dense sparse-set container.
+template<typename Component>
+using ComponentStorage = typename std::conditional<std::is_empty<Component>::value,
+        TagContainer<Component>, ComponentContainer<Component>>::type;
+
+// Iterates the entities that own every listed component, driven by whichever container is smallest.
+// The callback receives the entity followed by each component, in template order. each() hands out
+// const references through peek(), so a read-only join leaves change versions alone; each_mut() goes
+// through get() and stamps every component it visits as changed. Structural changes to the viewed
+// containers are not allowed while iterating.
+template<typename... Components>
+class View {
+    std::tuple<ComponentStorage<Components> &...> containers;
+
+    template<typename Visit, size_t... I>
+    void drive(Visit &visit, std::index_sequence<I...>) {
+        size_t sizes[] = {std::get<I>(containers).size()...};
+        size_t driver = std::min_element(sizes, sizes + sizeof...(I)) - sizes;
+        int expand[] = {0, (I == driver ? (std::get<I>(containers).each_entity(visit), 0) : 0)...};
+        (void) expand;
+    }
+
+    template<size_t... I>
+    bool matches(Entity e, std::index_sequence<I...>) {
+        bool found[] = {std::get<I>(containers).has(e)...};
+        return std::all_of(std::begin(found), std::end(found), [](bool b) { return b; });
+    }
+
+public:
+    View(ComponentStorage<Components> &... containers) : containers(containers...) {
+    }
+
+    template<typename F>
+    void each(F f) {
+        each(f, std::index_sequence_for<Components...>());
+    }
+
+    template<typename F>
+    void each_mut(F f) {
+        each_mut(f, std::index_sequence_for<Components...>());
+    }
+
+private:
+    template<typename F, size_t... I>
+    void each(F &f, std::index_sequence<I...> indices) {
+        auto visit = [&](Entity e) {
+            if (matches(e, indices))
+                f(e, static_cast<const Components &>(std::get<I>(containers).peek(e))...);
+        };
+        drive(visit, indices);
+    }
+
+    template<typename F, size_t... I>
+    void each_mut(F &f, std::index_sequence<I...> indices) {
+        auto visit = [&](Entity e) {
+            if (matches(e, indices))
+                f(e, std::get<I>(containers).get(e)...);
+        };
+        drive(visit, indices);
+    }
+};
+
+// Owns one container per component type in the list. Fan-out over all containers is expanded at
+// compile time, so there is no container list to keep in sync and no virtual call per container.
+template<typename... Components>
+class Registry {
+    static_assert(sizeof...(Components) <= 8 * sizeof(ComponentMask), "Too many component types for the signature mask");
+
+    std::tuple<ComponentStorage<Components>...> containers;
+    std::vector<Entity> pending_destroys;
+    SignatureTable signatures;
+    uint32_t change_tick = 1;
+
+    template<size_t... I>
+    void attach_all(std::index_sequence<I...>) {
+        int expand[] = {0, (std::get<I>(containers).attach(&signatures, I, &change_tick), 0)...};
+        (void) expand;
+    }
+
+    template<typename F, size_t... I>
+    void for_each_container(F &&f, std::index_sequence<I...>) {
+        int expand[] = {0, (f(std::get<I>(containers)), 0)...};
+        (void) expand;
+    }
+
+public:
+    Registry() {
+        attach_all(std::index_sequence_for<Components...>());
+    }
+
+    Registry(const Registry &) = delete;
+
+    Registry &operator=(const Registry &) = delete;
+
+    template<typename Component>
+    ComponentStorage<Component> &container() {
+        return std::get<ComponentStorage<Component>>(containers);
+    }
+
+    uint32_t current_tick() const {
+        return change_tick;
+    }
+
+    // A consumer of change queries stores the returned tick after it has caught up; anything written
+    // afterwards, even within the same frame, is stamped with a later tick and reported next time.
+    uint32_t advance_tick() {
+        return change_tick++;
+    }
+
+    template<typename F>
+    void for_each_container(F &&f) {
+        for_each_container(f, std::index_sequence_for<Components...>());
+    }
+
+    template<typename... ViewComponents>
+    View<ViewComponents...> view() {
+        return View<ViewComponents...>(container<ViewComponents>()...);
+    }
+
+    template<typename... MaskComponents>
+    ComponentMask mask_of() {
+        ComponentMask bits[] = {0, container<MaskComponents>().component_bit...};
+        ComponentMask mask = 0;
+        for (ComponentMask bit: bits)
+            mask |= bit;
+        return mask;
+    }
+
+    template<typename... MaskComponents>
+    bool has_all(Entity e) {
+        ComponentMask mask = mask_of<MaskComponents...>();
+        return Entity::alive(e) && (signatures.get(e.index()) & mask) == mask;
+    }
+
+    template<typename... MaskComponents>
+    bool has_any(Entity e) {
+        return Entity::alive(e) && (signatures.get(e.index()) & mask_of<MaskComponents...>()) != 0;
+    }
+
+    void clear_all_components() {
+        for_each_container([](auto &c) { c.clear(); });
+        pending_destroys.clear();
+        signatures.clear();
+    }
+
+    void list_all_components() {
+        printf("Debug info on all registry entries:\n");
+        for_each_container([](auto &c) {
+            if (c.size() > 0)
+                printf("%4d components of type %s\n", (int) c.size(), typeid(c).name());
+        });
+    }
+
+    void list_all_components_of(Entity e) {
+        printf("Debug info on components of entity %u:\n", (unsigned int) e);
+        for_each_container([&](auto &c) {
+            if (c.has(e))
+                printf("type %s\n", typeid(c).name());
+        });
+    }
+
+    // Only containers named in the entity's signature do any work.
+    void remove_all_components_of(Entity e) {
+        if (!Entity::alive(e))
+            return;
+        ComponentMask mask = signatures.get(e.index());
+        for_each_container([&](auto &c) {
+            if (mask & c.component_bit)
+                c.remove(e);
+        });
+        Entity::destroy(e);
+    }
+
+    // Captures every container, the signature table and the entity allocator in one buffer.
+    Snapshot snapshot() {
+        Snapshot out;
+        SnapshotWriter writer(out);
+        save_entity_pool(writer);
+        signatures.save(writer);
+        for_each_container([&](auto &c) { c.save(writer); });
+        return out;
+    }
+
+    // Replaces the whole registry with a snapshot from this process. Handles minted since the
+    // snapshot was taken are no longer valid afterwards.
+    void restore(const Snapshot &in) {
+        SnapshotReader reader(in);
+        load_entity_pool(reader);
+        signatures.load(reader);
+        advance_tick();
+        for_each_container([&](auto &c) { c.load(reader); });
+        assert(reader.complete() && "Snapshot has trailing bytes");
+        pending_destroys.clear();
+    }
+
+    // Safe to call while iterating any container; the entity is destroyed on the next flush().
+    void defer_remove_all_components_of(Entity e) {
+        pending_destroys.push_back(e);
+    }
+
+    // Applies every deferred insert, remove and destroy, one container at a time.
+    void flush() {
+        for_each_container([](auto &c) { c.flush(); });
+
+        std::vector<ComponentMask> masks;
+        masks.reserve(pending_destroys.size());
+        for (Entity e: pending_destroys)
+            masks.push_back(Entity::alive(e) ? signatures.get(e.index()) : 0);
+        for_each_container([&](auto &c) {
+            for (size_t i = 0; i < pending_destroys.size(); i++)
+                if (masks[i] & c.component_bit)
+                    c.remove(pending_destroys[i]);
+        });
+        for (Entity e: pending_destroys)
+            Entity::destroy(e);
+        pending_destroys.clear();
     }
 };
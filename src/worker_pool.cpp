@@ -0,0 +1,78 @@
+#include "worker_pool.hpp"
+
+#include <algorithm>
+
+WorkerPool::~WorkerPool() {
+    stop();
+}
+
+void WorkerPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &worker: workers)
+        worker.join();
+    workers.clear();
+    stopping = false;
+}
+
+void WorkerPool::set_thread_count(unsigned int count) {
+    stop();
+    for (unsigned int i = 1; i < count; i++)
+        workers.emplace_back(&WorkerPool::worker_loop, this, generation);
+}
+
+void WorkerPool::worker_loop(unsigned int first_generation) {
+    unsigned int seen = first_generation;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+        }
+        run_chunks();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--busy_workers == 0)
+                done.notify_one();
+        }
+    }
+}
+
+void WorkerPool::run_chunks() {
+    while (true) {
+        size_t begin = next_chunk++ * job_grain;
+        if (begin >= job_count)
+            return;
+        (*job)(begin, std::min(begin + job_grain, job_count));
+    }
+}
+
+void WorkerPool::parallel_for(size_t count, size_t grain, const std::function<void(size_t, size_t)> &f) {
+    grain = std::max(grain, (size_t) 1);
+    if (workers.empty() || count <= grain) {
+        for (size_t begin = 0; begin < count; begin += grain)
+            f(begin, std::min(begin + grain, count));
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &f;
+        job_count = count;
+        job_grain = grain;
+        next_chunk = 0;
+        busy_workers = (unsigned int) workers.size();
+        generation++;
+    }
+    wake.notify_all();
+    run_chunks();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&] { return busy_workers == 0; });
+    job = nullptr;
+}
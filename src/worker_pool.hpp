@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent threads that share index ranges with the calling thread. Threads are created once and
+// sleep between jobs, so a parallel_for costs a wake-up rather than a thread start.
+class WorkerPool {
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    unsigned int generation = 0;
+    unsigned int busy_workers = 0;
+    bool stopping = false;
+
+    const std::function<void(size_t, size_t)> *job = nullptr;
+    size_t job_count = 0;
+    size_t job_grain = 1;
+    std::atomic<size_t> next_chunk{0};
+
+    void worker_loop(unsigned int first_generation);
+
+    void run_chunks();
+
+    void stop();
+
+public:
+    WorkerPool() = default;
+
+    WorkerPool(const WorkerPool &) = delete;
+
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    ~WorkerPool();
+
+    // Total threads including the caller; 1 runs everything on the calling thread.
+    void set_thread_count(unsigned int count);
+
+    unsigned int thread_count() const {
+        return (unsigned int) workers.size() + 1;
+    }
+
+    // Calls f(begin, end) for consecutive chunks of `grain` indices covering [0, count), the last one
+    // possibly shorter, and returns once all have run. Chunk boundaries depend only on count and grain,
+    // never on which thread picks a chunk up.
+    void parallel_for(size_t count, size_t grain, const std::function<void(size_t, size_t)> &f);
+};
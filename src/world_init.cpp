@@ -1,6 +1,7 @@
 #include "world_init.hpp"
 #include "tiny_ecs_registry.hpp"
 #include "world_system.hpp"
+#include "physics_system.hpp"
 
 Entity createMotionEntity(
         RenderRequest request,
@@ -32,8 +33,16 @@ Entity createAngularMotionEntity(
         RenderRequest request,
         vec2 position, vec2 centre, float angular_velocity, float scale,
         float mass = 1.f, float radius = 0) {
-    auto e = createMotionEntity(request, position, centre, scale, angular_velocity, mass, radius);
-    registry.angular_motions.emplace(e);
+    auto e = createMotionEntity(request, position, {0.f, 0.f}, scale, 0.f, mass, radius);
+    AngularMotion &orbit = registry.angular_motions.emplace(e);
+    vec2 offset = position - centre;
+    double now = physics_system.simulation_time;
+    orbit.centre = centre;
+    orbit.radius = length(offset);
+    orbit.angular_rate = angular_velocity;
+    // Phased so the orbit passes through `position` now.
+    orbit.phase = (float) remainder(atan2(offset.y, offset.x) - angular_velocity * now, 2.0 * M_PI);
+    registry.motions.get(e).velocity = orbit.velocity_at(now);
     return e;
 }
 
@@ -50,24 +59,22 @@ Entity createAsteroid(std::uniform_real_distribution<float> &uniform_dist, std::
 
     float ra = floorf(uniform_dist(rng) * 10.f);
 
-    Entity entity;
-    if (ra < 3.f) {
-        entity = createMotionEntity(
-                {TEXTURE_ASSET_ID::ASTEROID, EFFECT_ASSET_ID::TEXTURED, GEOMETRY_BUFFER_ID::SPRITE},
-                {x, y}, {x_sign * -1.f * velocity, y_sign * -1.f * velocity}, input_scale);
-    } else if (ra < 6.f) {
-        entity = createMotionEntity(
-                {TEXTURE_ASSET_ID::ASTEROID2, EFFECT_ASSET_ID::TEXTURED, GEOMETRY_BUFFER_ID::SPRITE},
-                {x, y}, {x_sign * -1.f * velocity, y_sign * -1.f * velocity}, input_scale);
-    } else {
-        entity = createMotionEntity(
-                {TEXTURE_ASSET_ID::ASTEROID3, EFFECT_ASSET_ID::TEXTURED, GEOMETRY_BUFFER_ID::SPRITE},
-                {x, y}, {x_sign * -1.f * velocity, y_sign * -1.f * velocity}, input_scale);
-    }
+    TEXTURE_ASSET_ID texture = TEXTURE_ASSET_ID::ASTEROID3;
+    if (ra < 3.f)
+        texture = TEXTURE_ASSET_ID::ASTEROID;
+    else if (ra < 6.f)
+        texture = TEXTURE_ASSET_ID::ASTEROID2;
+
+    Entity entity = createMotionEntity(
+            {texture, EFFECT_ASSET_ID::TEXTURED, GEOMETRY_BUFFER_ID::SPRITE},
+            {x, y}, {x_sign * -1.f * velocity, y_sign * -1.f * velocity}, input_scale);
+    // Collision circle: the rock fills about 80% of the sprite's width.
+    Motion &motion = registry.motions.get(entity);
+    motion.radius = 0.4f * motion.scale.x;
 
     registry.asteroids.emplace(entity);
     registry.ignore_physics.emplace(entity);
-    Timer t = registry.timers.emplace(entity);
+    Timer &t = registry.timers.emplace(entity);
     t.ms = 5000.f;
 
     return entity;
@@ -95,6 +95,7 @@ void WorldSystem::init() {
 
     Entity p;
     registry.phases.emplace(p);
+    blank_world = registry.snapshot();
 
     callback_system.add_keybind(GLFW_KEY_R, [](GLFWwindow *) { world_system.restart_game(); });
 
@@ -116,6 +117,13 @@ void WorldSystem::init() {
     callback_system.add_keybind(GLFW_KEY_PERIOD, GLFW_RELEASE, GLFW_MOD_SHIFT,
                                 [](GLFWwindow *) { world_system.change_speed(0.1f); });
 
+    callback_system.add_keybind(GLFW_KEY_G, [](GLFWwindow *) { physics_system.cycle_gravity_solver(); });
+    callback_system.add_keybind(GLFW_KEY_I, [](GLFWwindow *) { physics_system.cycle_integrator(); });
+    callback_system.add_keybind(GLFW_KEY_T, [](GLFWwindow *) { physics_system.cycle_thread_count(); });
+
+    callback_system.add_keybind(GLFW_KEY_F5, [](GLFWwindow *) { world_system.save_state(); });
+    callback_system.add_keybind(GLFW_KEY_F9, [](GLFWwindow *) { world_system.load_state(); });
+
     callback_system.add_on_mouse_move_callback([](GLFWwindow *w, double, double) { world_system.on_mouse_move(w); });
 
     restart_game();
@@ -128,7 +136,7 @@ void WorldSystem::on_mouse_move(GLFWwindow *) {
     Phase &phase = registry.phases.components[0];
 
     Entity player_planet = registry.planets.entities[phase.player];
-    Motion planet_motion = registry.motions.get(player_planet);
+    Motion planet_motion = registry.motions.peek(player_planet);
 
     vec2 pos = camera_system.get_mouse_on_camera(window);
     vec2 mouse_pos_on_camera = vec2(2.f * pos.x - 1.f, 1.f - 2.f * pos.y);
@@ -145,16 +153,16 @@ void WorldSystem::on_mouse_move(GLFWwindow *) {
 }
 
 void setPlayersSimulation(bool phase) {
-    for (const auto &ent: registry.players.entities) {
+    registry.players.each_entity([&](Entity ent) {
         Phase &p = registry.phases.get(ent);
         p.simulation = phase;
-    }
+    });
 }
 
 bool WorldSystem::step(float timeSpentFromLastUpdate) {
 
-    while (registry.debugComponents.entities.size() > 0)
-        registry.remove_all_components_of(registry.debugComponents.entities.back());
+    registry.debugComponents.each_entity([](Entity e) { registry.defer_remove_all_components_of(e); });
+    registry.flush();
 
     auto &motion_container = registry.motions;
 
@@ -163,42 +171,6 @@ bool WorldSystem::step(float timeSpentFromLastUpdate) {
     float topBoundary = -scene_height_px / 2.f;
     float bottomBoundary = -topBoundary;
 
-    for (int i = 0; i < registry.asteroids.components.size(); i++) {
-        Motion &motion = registry.motions.get(registry.asteroids.entities[i]);
-
-        Motion &sun_motion = registry.motions.get(registry.suns.entities[0]);
-        float distance = pow(pow(sun_motion.position.x - motion.position.x, 2) +
-                             pow(sun_motion.position.y - motion.position.y, 2),
-                             0.5);
-        if (distance < 0.4 * motion.scale.x) {
-            Mix_PlayChannel(-1, world_system.missile_destroyed_sound, 0);
-            registry.remove_all_components_of(registry.asteroids.entities[i]);
-        }
-
-        for (int j = 0; j < registry.missiles.components.size(); j++) {
-            Motion &missile_motion = registry.motions.get(registry.missiles.entities[j]);
-            float distance = pow(pow(missile_motion.position.x - motion.position.x, 2) +
-                                 pow(missile_motion.position.y - motion.position.y, 2),
-                                 0.5);
-            if (distance < 0.4 * motion.scale.x) {
-                registry.remove_all_components_of(registry.asteroids.entities[i]);
-                registry.remove_all_components_of(registry.missiles.entities[j]);
-                Mix_PlayChannel(-1, world_system.missile_destroyed_sound, 0);
-            }
-        }
-
-        for (int j = 0; j < registry.planets.components.size(); j++) {
-            Motion &planet_motion = registry.motions.get(registry.planets.entities[j]);
-            float distance = pow(pow(planet_motion.position.x - motion.position.x, 2) +
-                                 pow(planet_motion.position.y - motion.position.y, 2),
-                                 0.5);
-            if (distance < 0.4 * motion.scale.x) {
-                Mix_PlayChannel(-1, world_system.game_over_sound, 0);
-                registry.remove_all_components_of(registry.asteroids.entities[i]);
-            }
-        }
-    }
-
     for (int i = (int) motion_container.components.size() - 1; i >= 0; --i) {
         Motion &motion = motion_container.components[i];
         float entityLeft = motion.position.x - abs(motion.scale.x);
@@ -206,10 +178,11 @@ bool WorldSystem::step(float timeSpentFromLastUpdate) {
         float entityTop = motion.position.y - abs(motion.scale.y);
         float entityBottom = motion.position.y + abs(motion.scale.y);
         if (registry.missiles.has(motion_container.entities[i])) {
+            Entity missile = motion_container.entities[i];
             createParticle(motion.position - abs(motion.scale.x) * normalize(motion.velocity) / 2.f, motion.scale.y);
             if (entityLeft > rightBoundary || entityRight < leftBoundary ||
                 entityTop > bottomBoundary || entityBottom < topBoundary) {
-                registry.remove_all_components_of(motion_container.entities[i]);
+                registry.defer_remove_all_components_of(missile);
             }
         }
     }
@@ -226,7 +199,7 @@ bool WorldSystem::step(float timeSpentFromLastUpdate) {
             speed.ms -= timeSpentFromLastUpdate;
 
             if (speed.ms < 0 || speed.boost < 1.f) {
-                registry.speed_up.remove(registry.speed_up.entities[i]);
+                registry.speed_up.defer_remove(registry.speed_up.entities[i]);
             }
         }
     }
@@ -238,19 +211,20 @@ bool WorldSystem::step(float timeSpentFromLastUpdate) {
         Entity entity = registry.timers.entities[i];
         timer.ms -= timeSpentFromLastUpdate;
         if (timer.ms < 0) {
+            if (timer.death)
+                registry.defer_remove_all_components_of(entity);
+            else
+                registry.timers.defer_remove(entity);
+
             if (registry.phases.has(entity)) {
                 shift_stage();
             }
-            if (registry.asteroids.has(entity) && registry.asteroids.components.size() < MAX_ASTEROIDS) {
+            if (registry.asteroids.has(entity) && registry.asteroids.size() < MAX_ASTEROIDS) {
                 createAsteroid(uniform_dist, rng);
             }
-
-            if (timer.death)
-                registry.remove_all_components_of(entity);
-            else
-                registry.timers.remove(entity);
         }
     }
+    registry.flush();
 
     for (int i = 0; i < registry.planets.components.size(); i++) {
         Planet &p = registry.planets.components[i];
@@ -276,19 +250,10 @@ void WorldSystem::restart_game() {
 
     current_speed = 1.f;
 
-    while (registry.motions.entities.size() > 0)
-        registry.remove_all_components_of(registry.motions.entities.back());
-    while (registry.huds.entities.size() > 0)
-        registry.remove_all_components_of(registry.motions.entities.back());
-    while (registry.timers.entities.size() > 0) {
-        Entity &e = registry.timers.entities.back();
-        Timer &t = registry.timers.components.back();
-        if (t.death)
-            registry.remove_all_components_of(e);
-        else
-            registry.timers.remove(e);
-    }
+    WorldPhase world_phase = registry.phases.components[0].phase;
+    registry.restore(blank_world);
     Phase &phase = registry.phases.components[0];
+    phase.phase = world_phase;
     phase.simulation = false;
     phase.player = 0;
 
@@ -359,9 +324,29 @@ void WorldSystem::restart_game() {
     highlight = createHUDComponent(highlight_pos, {30.f, 30.f}, TEXTURE_ASSET_ID::HIGHLIGHT);
 }
 
+void WorldSystem::save_state() {
+    saved_state = registry.snapshot();
+    saved_handles = {aimer, worm1, worm2, highlight};
+    saved_simulation_time = physics_system.simulation_time;
+}
+
+void WorldSystem::load_state() {
+    if (saved_state.empty())
+        return;
+    registry.restore(saved_state);
+    aimer = Entity::from_id(saved_handles[0]);
+    worm1 = Entity::from_id(saved_handles[1]);
+    worm2 = Entity::from_id(saved_handles[2]);
+    highlight = Entity::from_id(saved_handles[3]);
+    // Orbits are read off the physics clock, so it rewinds with the bodies.
+    physics_system.simulation_time = saved_simulation_time;
+
+    Phase &phase = registry.phases.components[0];
+    camera_system.lock_on(registry.planets.entities[phase.player]);
+}
+
 void WorldSystem::handle_collisions() {
     auto &collisionsRegistry = registry.collisions;
-    std::vector<Entity> marked_entities;
     for (uint i = 0; i < collisionsRegistry.components.size(); i++) {
         Entity entity = collisionsRegistry.entities[i];
         Entity entity_other = collisionsRegistry.components[i].other_entity;
@@ -396,15 +381,20 @@ void WorldSystem::handle_collisions() {
                         render_system.changeAnimation(entity_other, anime);
                     }
                 }
-                marked_entities.push_back(entity);
+                registry.defer_remove_all_components_of(entity);
             }
 
 
+        } else if (registry.asteroids.has(entity)) {
+            // A missile hit already played its sound in the physics system.
+            if (registry.planets.has(entity_other))
+                Mix_PlayChannel(-1, world_system.game_over_sound, 0);
+            else if (!registry.missiles.has(entity_other))
+                Mix_PlayChannel(-1, world_system.missile_destroyed_sound, 0);
+            registry.defer_remove_all_components_of(entity);
         }
     }
-    for (Entity e: marked_entities) {
-        registry.remove_all_components_of(e);
-    }
+    registry.flush();
     registry.collisions.clear();
 }
 
@@ -422,7 +412,7 @@ void WorldSystem::spawn_missile_on_mouse(VARIANT m_type) {
     glfwGetWindowSize(window, &width, &height);
 
     Entity player_planet = registry.planets.entities[phase.player];
-    Motion planet_motion = registry.motions.get(player_planet);
+    Motion planet_motion = registry.motions.peek(player_planet);
     vec2 pos = camera_system.get_mouse_on_camera(window);
     vec2 mouse_pos_on_camera = vec2(2.f * pos.x - 1.f, 1.f - 2.f * pos.y);
     mat3 proj_matrix = inverse(camera_system.get_projection_matrix(false));
@@ -6,6 +6,7 @@
 #include <vector>
 #include <random>
 #include <list>
+#include <array>
 
 #define SDL_MAIN_HANDLED
 
@@ -47,6 +48,10 @@ public:
 
     void shift_phase();
 
+    void save_state();
+
+    void load_state();
+
     Mix_Music *background_music;
     Mix_Chunk *missile_fire_sound;
     Mix_Chunk *missile_destroyed_sound;
@@ -63,6 +68,12 @@ private:
     Entity worm1;
     Entity worm2;
     Entity highlight;
+
+    // Registry state before any world entity exists; restart_game() restores it instead of tearing down.
+    Snapshot blank_world;
+    Snapshot saved_state;
+    std::array<unsigned int, 4> saved_handles;
+    double saved_simulation_time = 0.0;
     std::default_random_engine rng;
     std::uniform_real_distribution<float> uniform_dist;
 };